@@ -0,0 +1,164 @@
+#include "depthbuffer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+DepthPlane DepthPlane::FromTriangle(const Triangle& trig)
+{
+    const glm::vec4& p0 = trig.pos[0];
+    glm::vec3 e1 = glm::vec3(trig.pos[1]) - glm::vec3(p0);
+    glm::vec3 e2 = glm::vec3(trig.pos[2]) - glm::vec3(p0);
+
+    // normal of the plane through the vertices; degenerate triangles get a constant depth
+    glm::vec3 n = glm::cross(e1, e2);
+    if (n.z == 0)
+        return { 0, 0, p0.z };
+
+    float a = -n.x / n.z;
+    float b = -n.y / n.z;
+    return { a, b, p0.z - a * p0.x - b * p0.y };
+}
+
+DepthBuffer::DepthBuffer(uint32_t width, uint32_t height, const std::vector<glm::vec2>& offsets, float clearDepth) :
+    width(width),
+    height(height),
+    tilesX((width + TILE - 1) / TILE),
+    tilesY((height + TILE - 1) / TILE),
+    offsets(offsets),
+    clearDepth(clearDepth),
+    blockSize(static_cast<size_t>(TILE) * TILE * offsets.size()),
+    tiles(static_cast<size_t>(tilesX) * tilesY),
+    selectorBlocks(0),
+    valueBlocks(0)
+{
+    this->Clear();
+}
+
+void DepthBuffer::Clear()
+{
+    for (Tile& tile : this->tiles)
+    {
+        tile.zmin = tile.zmax = this->clearDepth;
+        tile.state = TileState::CLEAR;
+        tile.planeCount = 0;
+    }
+    this->selectorBlocks = 0;
+    this->valueBlocks = 0;
+}
+
+float DepthBuffer::GetFromTile(const Tile& tile, uint32_t x, uint32_t y, uint32_t sample) const
+{
+    if (tile.state == TileState::CLEAR)
+        return this->clearDepth;
+
+    size_t index = tile.block * this->blockSize + GetSampleIndex(x, y, sample);
+    if (tile.state == TileState::FULL)
+        return this->values[index];
+
+    uint8_t selector = this->selectors[index];
+    if (selector == 0)
+        return this->clearDepth;
+    glm::vec2 pos = GetSamplePosition(x, y, sample);
+    return tile.planes[selector - 1].Evaluate(pos.x, pos.y);
+}
+
+float DepthBuffer::Get(uint32_t x, uint32_t y, uint32_t sample) const
+{
+    size_t tileIndex = GetTileIndex(x, y);
+    return GetFromTile(this->tiles[tileIndex], x, y, sample);
+}
+
+float DepthBuffer::GetPixel(uint32_t x, uint32_t y) const
+{
+    size_t tileIndex = GetTileIndex(x, y);
+    const Tile& tile = this->tiles[tileIndex];
+    if (tile.state == TileState::CLEAR)
+        return this->clearDepth;
+
+    float depth = GetFromTile(tile, x, y, 0);
+    for (uint32_t s = 1; s < GetSampleCount(); ++s)
+        depth = std::max(depth, GetFromTile(tile, x, y, s));
+    return depth;
+}
+
+bool DepthBuffer::Test(uint32_t x, uint32_t y, uint32_t sample, float depth) const
+{
+    size_t tileIndex = GetTileIndex(x, y);
+    const Tile& tile = this->tiles[tileIndex];
+    if (depth > tile.zmax)
+        return true;
+    if (depth <= tile.zmin)
+        return false;
+    return depth > GetFromTile(tile, x, y, sample);
+}
+
+void DepthBuffer::Set(uint32_t x, uint32_t y, uint32_t sample, float depth, const DepthPlane& plane)
+{
+    if (x >= this->width || y >= this->height)
+        return;
+
+    size_t tileIndex = GetTileIndex(x, y);
+    Tile& tile = this->tiles[tileIndex];
+
+    if (tile.state == TileState::CLEAR)
+    {
+        tile.block = this->selectorBlocks++;
+        size_t needed = static_cast<size_t>(this->selectorBlocks) * this->blockSize;
+        if (this->selectors.size() < needed)
+            this->selectors.resize(needed);
+        std::memset(&this->selectors[tile.block * this->blockSize], 0, this->blockSize);
+
+        tile.state = TileState::PLANES;
+        tile.planes[0] = plane;
+        tile.planeCount = 1;
+    }
+
+    if (tile.state == TileState::PLANES)
+    {
+        uint8_t selector = 0;
+        for (uint8_t i = 0; i < tile.planeCount && selector == 0; ++i)
+            if (tile.planes[i] == plane)
+                selector = i + 1;
+        if (selector == 0 && tile.planeCount < 2)
+        {
+            tile.planes[tile.planeCount++] = plane;
+            selector = tile.planeCount;
+        }
+
+        if (selector != 0)
+            this->selectors[tile.block * this->blockSize + GetSampleIndex(x, y, sample)] = selector;
+        else
+            Decompress(tile, tileIndex);
+    }
+
+    if (tile.state == TileState::FULL)
+        this->values[tile.block * this->blockSize + GetSampleIndex(x, y, sample)] = depth;
+
+    tile.zmin = std::min(tile.zmin, depth);
+    tile.zmax = std::max(tile.zmax, depth);
+}
+
+void DepthBuffer::Decompress(Tile& tile, size_t tileIndex)
+{
+    uint32_t block = this->valueBlocks++;
+    size_t needed = static_cast<size_t>(this->valueBlocks) * this->blockSize;
+    if (this->values.size() < needed)
+        this->values.resize(needed);
+
+    uint32_t x0 = static_cast<uint32_t>(tileIndex % this->tilesX) * TILE;
+    uint32_t y0 = static_cast<uint32_t>(tileIndex / this->tilesX) * TILE;
+    for (uint32_t y = y0; y < y0 + TILE; ++y)
+        for (uint32_t x = x0; x < x0 + TILE; ++x)
+            for (uint32_t s = 0; s < GetSampleCount(); ++s)
+                this->values[block * this->blockSize + GetSampleIndex(x, y, s)] = GetFromTile(tile, x, y, s);
+
+    tile.state = TileState::FULL;
+    tile.block = block;
+}
+
+size_t DepthBuffer::GetFullTileCount() const
+{
+    return this->valueBlocks;
+}
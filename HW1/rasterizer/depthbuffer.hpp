@@ -0,0 +1,117 @@
+#ifndef DEPTHBUFFER_H
+#define DEPTHBUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+
+// Multi-sampled depth storage with tile compression.
+//
+// Depth follows a reversed-Z convention: a sample at view distance d stores nearClip / d, so the near plane
+// maps to 1, the far plane to nearClip / farClip and infinity to 0; larger values are closer. Float precision
+// is densest around 0, which is where the far away geometry ends up with this mapping.
+//
+// The screen is split into TILE x TILE pixel tiles. Each tile keeps conservative min/max depth bounds, and
+// stays compressed as long as its samples are covered by at most two triangles: it then only stores the depth
+// planes of those triangles and a one byte plane selector per sample. A third plane decompresses the tile to
+// one float per sample. Clearing resets the tile headers only.
+
+// Depth of a triangle as an affine function of the screen position
+struct DepthPlane
+{
+    float a, b, c;
+
+    // The plane through the (x, y, z) of the three vertices; z must hold the depth of each vertex
+    static DepthPlane FromTriangle(const Triangle& trig);
+
+    inline float Evaluate(float x, float y) const { return a * x + b * y + c; }
+    inline bool operator== (const DepthPlane& p) const { return a == p.a && b == p.b && c == p.c; }
+};
+
+class DepthBuffer
+{
+public:
+    static constexpr uint32_t TILE = 8;
+
+    /**
+     * @param width: horizontal resolution in pixels
+     * @param height: vertical resolution in pixels
+     * @param offsets: position of every sample inside its pixel, in [0, 1)^2
+     * @param clearDepth: the depth all samples are reset to
+     */
+    DepthBuffer(uint32_t width, uint32_t height, const std::vector<glm::vec2>& offsets, float clearDepth);
+
+    // Reset all samples to the clear depth
+    void Clear();
+
+    // Depth stored at a sample
+    float Get(uint32_t x, uint32_t y, uint32_t sample) const;
+
+    // Closest depth among the samples of a pixel
+    float GetPixel(uint32_t x, uint32_t y) const;
+
+    /**
+     * Check whether a depth is strictly closer than the one stored at a sample. The tile bounds answer most queries
+     * without touching the sample itself.
+     */
+    bool Test(uint32_t x, uint32_t y, uint32_t sample, float depth) const;
+
+    /**
+     * Store the depth of a sample.
+     * @param depth: the depth to store; must be `plane` evaluated at the sample position
+     * @param plane: the depth plane of the triangle covering the sample, used to keep the tile compressed
+     */
+    void Set(uint32_t x, uint32_t y, uint32_t sample, float depth, const DepthPlane& plane);
+
+    // The position of a sample in screen space
+    inline glm::vec2 GetSamplePosition(uint32_t x, uint32_t y, uint32_t sample) const
+    {
+        return glm::vec2(static_cast<float>(x) + offsets[sample].x, static_cast<float>(y) + offsets[sample].y);
+    }
+
+    inline uint32_t GetSampleCount() const { return static_cast<uint32_t>(offsets.size()); }
+    inline float GetClearDepth() const { return clearDepth; }
+
+    // Number of tiles currently decompressed to one float per sample
+    size_t GetFullTileCount() const;
+
+private:
+    enum class TileState : uint8_t { CLEAR, PLANES, FULL };
+
+    struct Tile
+    {
+        float zmin, zmax;               // conservative bounds of all the samples in the tile
+        TileState state;
+        uint8_t planeCount;
+        uint32_t block;                 // selector block while PLANES, value block once FULL
+        DepthPlane planes[2];
+    };
+
+    inline size_t GetTileIndex(uint32_t x, uint32_t y) const { return (y / TILE) * tilesX + x / TILE; }
+    inline size_t GetSampleIndex(uint32_t x, uint32_t y, uint32_t sample) const
+    {
+        return ((y % TILE) * TILE + x % TILE) * offsets.size() + sample;
+    }
+
+    float GetFromTile(const Tile& tile, uint32_t x, uint32_t y, uint32_t sample) const;
+
+    // Expand a PLANES tile to one float per sample
+    void Decompress(Tile& tile, size_t tileIndex);
+
+private:
+    uint32_t width, height;
+    uint32_t tilesX, tilesY;
+    std::vector<glm::vec2> offsets;
+    float clearDepth;
+    size_t blockSize;                   // samples per tile
+
+    std::vector<Tile> tiles;
+
+    // Blocks are handed out on demand and only reclaimed by Clear(), so a frame never reallocates once warm
+    std::vector<uint8_t> selectors;     // 0 for a cleared sample, i + 1 for planes[i]
+    std::vector<float> values;
+    uint32_t selectorBlocks, valueBlocks;
+};
+
+#endif
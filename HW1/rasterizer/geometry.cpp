@@ -0,0 +1,109 @@
+#include "geometry.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace
+{
+    // Items handed to a worker at once; large enough to amortize the scheduling, small enough to balance
+    constexpr size_t VERTEX_GRAIN = 8192;
+    constexpr size_t FACE_GRAIN = 4096;
+
+    // Index of the draw call owning item i, given the running item offsets of the calls
+    size_t FindCall(const std::vector<size_t>& start, size_t i)
+    {
+        return std::upper_bound(start.begin(), start.end(), i) - start.begin() - 1;
+    }
+}
+
+void TriangleStream::Resize(size_t triangleCount)
+{
+    for (std::vector<float>* array : { &x, &y, &depth, &wx, &wy, &wz, &nx, &ny, &nz, &nw })
+        array->resize(3 * triangleCount);
+}
+
+Triangle TriangleStream::GetTransformed(size_t t) const
+{
+    Triangle trig;
+    for (size_t v = 0; v < 3; ++v)
+        trig.pos[v] = glm::vec4(this->x[3 * t + v], this->y[3 * t + v], this->depth[3 * t + v], 1);
+    return trig;
+}
+
+Triangle TriangleStream::GetOriginal(size_t t) const
+{
+    Triangle trig;
+    for (size_t v = 0; v < 3; ++v)
+    {
+        trig.pos[v] = glm::vec4(this->wx[3 * t + v], this->wy[3 * t + v], this->wz[3 * t + v], 1);
+        trig.normal[v] = glm::vec4(this->nx[3 * t + v], this->ny[3 * t + v], this->nz[3 * t + v], this->nw[3 * t + v]);
+    }
+    return trig;
+}
+
+void RunGeometryStage(const std::vector<DrawCall>& calls, size_t shapeCount, const glm::mat4& viewxprojection, float nearClip,
+    TriangleStream& stream)
+{
+    // Lay the vertices and the faces of all the calls out one after another; the offsets fix the output order
+    std::vector<size_t> vertexStart(calls.size() + 1, 0), faceStart(calls.size() + 1, 0);
+    for (size_t c = 0; c < calls.size(); ++c)
+    {
+        vertexStart[c + 1] = vertexStart[c] + calls[c].mesh->GetVertexCount();
+        faceStart[c + 1] = faceStart[c] + calls[c].mesh->GetFaceCount();
+    }
+
+    stream.shapeStart.assign(shapeCount + 1, faceStart.back());
+    for (size_t c = calls.size(); c-- > 0; )
+        stream.shapeStart[calls[c].shape] = faceStart[c];
+    for (size_t s = shapeCount; s-- > 0; )
+        stream.shapeStart[s] = std::min(stream.shapeStart[s], stream.shapeStart[s + 1]);
+
+    // Vertex step: a chunk may span several calls
+    VertexBatch batch;
+    batch.Resize(vertexStart.back());
+    ParallelFor(vertexStart.back(), VERTEX_GRAIN, [&](size_t begin, size_t end)
+    {
+        for (size_t c = FindCall(vertexStart, begin); begin < end; ++c)
+        {
+            size_t stop = std::min(end, vertexStart[c + 1]);
+            TransformVertices(*calls[c].mesh, begin - vertexStart[c], stop - vertexStart[c], calls[c].model, viewxprojection, batch, begin);
+            begin = stop;
+        }
+    });
+
+    // Assembly step: gather the corners of every face and apply the perspective divide. w is the view space z, negative
+    //   in front of the camera, so 1 / w, and with it the reversed-Z depth, is affine in screen space
+    stream.Resize(faceStart.back());
+    ParallelFor(faceStart.back(), FACE_GRAIN, [&](size_t begin, size_t end)
+    {
+        for (size_t c = FindCall(faceStart, begin); begin < end; ++c)
+        {
+            size_t stop = std::min(end, faceStart[c + 1]);
+            const std::vector<uint32_t>& indices = calls[c].mesh->indices;
+            const size_t base = vertexStart[c];
+            for (size_t f = begin; f < stop; ++f)
+            {
+                const uint32_t* face = &indices[3 * (f - faceStart[c])];
+                for (size_t v = 0; v < 3; ++v)
+                {
+                    const size_t i = base + face[v], o = 3 * f + v;
+                    const float w = batch.sw[i];
+                    stream.x[o] = batch.sx[i] / w;
+                    stream.y[o] = batch.sy[i] / w;
+                    stream.depth[o] = -nearClip / w;
+                    stream.wx[o] = batch.wx[i];
+                    stream.wy[o] = batch.wy[i];
+                    stream.wz[o] = batch.wz[i];
+                    stream.nx[o] = batch.nx[i];
+                    stream.ny[o] = batch.ny[i];
+                    stream.nz[o] = batch.nz[i];
+                    stream.nw[o] = batch.nw[i];
+                }
+            }
+            begin = stop;
+        }
+    });
+}
@@ -0,0 +1,59 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "mesh.hpp"
+
+// The geometry stage: transforms every visible instance and assembles its faces into a triangle stream,
+// which the rasterization stage then consumes in order.
+
+// One instance of one shape, at the level of detail selected for it
+struct DrawCall
+{
+    uint32_t shape;
+    const MeshLevel* mesh;
+    glm::mat4 model;
+};
+
+// Assembled triangles in SoA layout; corner v of triangle t is stored at index 3 * t + v
+class TriangleStream
+{
+public:
+    void Resize(size_t triangleCount);
+
+    inline size_t GetTriangleCount() const { return this->x.size() / 3; }
+
+    // triangles of shape s are [GetShapeBegin(s), GetShapeEnd(s)); shapes without visible instance are empty
+    inline size_t GetShapeBegin(size_t s) const { return s < this->shapeStart.size() ? this->shapeStart[s] : GetTriangleCount(); }
+    inline size_t GetShapeEnd(size_t s) const { return GetShapeBegin(s + 1); }
+
+    // the triangle in screen space, homogenized, with the depth of the vertices as z
+    Triangle GetTransformed(size_t t) const;
+
+    // the triangle in world space, with the normals of its corners
+    Triangle GetOriginal(size_t t) const;
+
+public:
+    std::vector<float> x, y;                    // screen space positions after the perspective divide
+    std::vector<float> depth;                   // reversed-Z depth, nearClip / view distance; see `depthbuffer.hpp`
+    std::vector<float> wx, wy, wz;              // world space positions
+    std::vector<float> nx, ny, nz, nw;          // world space normals
+    std::vector<size_t> shapeStart;             // first triangle of every shape, followed by the triangle count
+};
+
+/**
+ * Transform the vertices of all the draw calls and assemble their faces into the stream.
+ * Both steps run in parallel chunks; the triangles keep the order of the draw calls and of the faces in each of them.
+ * @param calls: the draw calls, sorted by shape
+ * @param shapeCount: number of shapes in the scene
+ * @param viewxprojection: the matrix from world space to screen space
+ * @param nearClip: distance to the near plane, which gets depth 1
+ * @param stream: receives the assembled triangles
+ */
+void RunGeometryStage(const std::vector<DrawCall>& calls, size_t shapeCount, const glm::mat4& viewxprojection, float nearClip,
+    TriangleStream& stream);
+
+#endif
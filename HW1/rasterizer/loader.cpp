@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 
+#include "raster_kernels.hpp"
 #include "../thirdparty/fkyaml/node.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION 
@@ -74,6 +75,10 @@ void LoadQuat(const fkyaml::node& parent, std::string tag, glm::quat& quat)
     else \
         throw fkyaml::exception(("missing tag " + std::string(#tag)).c_str());
 
+#define LOAD_OPT_DATA_FROM_YAML(var, node, tag, TYPE) \
+    if (node.contains(#tag)) \
+        var = node[#tag].get_value<TYPE>();
+
 #define LOAD_DEF_DATA_FROM_YAML(var, node, tag, TYPE) \
     TYPE var; \
     LOAD_DATA_FROM_YAML(var, node, tag, TYPE)
@@ -96,6 +101,36 @@ void LoadQuat(const fkyaml::node& parent, std::string tag, glm::quat& quat)
 #define LOAD_COLOR_FROM_YAML(node, tag, vec)    LoadColor(node, #tag, vec);
 #define LOAD_QUAT_FROM_YAML(node, tag, vec)     LoadQuat(node, #tag, vec);
 
+MeshTransform LoadTransform(const fkyaml::node& node)
+{
+    glm::quat rotation;
+    glm::vec3 translation, scale;
+    LOAD_QUAT_FROM_YAML(node, rotation, rotation)
+    LOAD_VEC3_FROM_YAML(node, translation, translation)
+    LOAD_VEC3_FROM_YAML(node, scale, scale)
+    return MeshTransform(rotation, translation, scale);
+}
+
+void LoadTransformList(const fkyaml::node& node, std::vector<MeshTransform>& transforms)
+{
+    if (!node.is_sequence())
+        throw fkyaml::exception("instances must be a list of transforms or a file name");
+    transforms.reserve(transforms.size() + node.size());
+    for (auto& subnode : node)
+        transforms.push_back(LoadTransform(subnode));
+}
+
+void LoadTransformFile(const std::string& filename, std::vector<MeshTransform>& transforms)
+{
+    std::ifstream ifs(filename);
+    if (!ifs)
+    {
+        std::string msg = "error opening instance file " + filename;
+        throw fkyaml::exception(msg.c_str());
+    }
+    LoadTransformList(fkyaml::node::deserialize(ifs), transforms);
+}
+
 Loader::Loader(std::string filename) : Loader() 
     {
         this->filename = filename;
@@ -184,19 +219,25 @@ bool Loader::LoadYaml()
             LOAD_DATA_FROM_YAML(camera.nearClip, cameraNode, nearClip, float)
             LOAD_DATA_FROM_YAML(camera.farClip, cameraNode, farClip, float)
 
-            // Load Transforms
+            // Load Transforms. An entry is either a single transform, or lists all the instances of its
+            //   shape under `instances`, inline or as the name of a yaml file holding the list
             LOAD_NODE_FROM_YAML_NOERROR(transformNode, root, transforms)
             if (transformNode != root)
             {
                 for (auto& subnode : transformNode)
                 {
-                    glm::quat rotation;
-                    glm::vec3 translation, scale;
-                    LOAD_QUAT_FROM_YAML(subnode, rotation, rotation)
-                    LOAD_VEC3_FROM_YAML(subnode, translation, translation)
-                    LOAD_VEC3_FROM_YAML(subnode, scale, scale)
-                    glm::vec3 scale3(scale);
-                    this->transforms.emplace_back(rotation, translation, scale3);
+                    std::vector<MeshTransform> instances;
+                    if (subnode.contains("instances"))
+                    {
+                        auto instanceNode = subnode["instances"];
+                        if (instanceNode.is_string())
+                            LoadTransformFile(instanceNode.get_value<std::string>(), instances);
+                        else
+                            LoadTransformList(instanceNode, instances);
+                    }
+                    else
+                        instances.push_back(LoadTransform(subnode));
+                    this->transforms.push_back(std::move(instances));
                 }
             }
 
@@ -216,6 +257,22 @@ bool Loader::LoadYaml()
                 }
             }
 
+            // Load LOD settings; every field is optional and LODs are built with the defaults without the tag
+            if (root.contains("lod"))
+            {
+                auto lodNode = root["lod"];
+                LOAD_OPT_DATA_FROM_YAML(this->lodConfig.enabled, lodNode, enabled, bool)
+                LOAD_OPT_DATA_FROM_YAML(this->lodConfig.maxLevels, lodNode, levels, uint32_t)
+                LOAD_OPT_DATA_FROM_YAML(this->lodConfig.reduction, lodNode, reduction, float)
+                LOAD_OPT_DATA_FROM_YAML(this->lodConfig.minFaces, lodNode, minFaces, uint32_t)
+                LOAD_OPT_DATA_FROM_YAML(this->lodConfig.threshold, lodNode, threshold, float)
+
+                if (this->lodConfig.reduction <= 0.f || this->lodConfig.reduction >= 1.f)
+                    throw fkyaml::exception("invalid lod reduction: must be in (0, 1)");
+                if (this->lodConfig.threshold < 0.f)
+                    throw fkyaml::exception("invalid lod threshold: must not be negative");
+            }
+
             if (this->type == TestType::SHADING)
             {
                 LOAD_DATA_FROM_YAML(this->specularExponent, root, exponent, float)
@@ -235,6 +292,24 @@ bool Loader::LoadYaml()
             {
                 this->AAConfig = AntiAliasConfig::SSAA;
                 LOAD_DATA_FROM_YAML(this->AASpp, root, samples, uint32_t)
+                if (this->AASpp == 0)
+                    throw fkyaml::exception("invalid samples: SSAA needs at least one");
+                // the SSAA kernels only exist for powers of two up to MAX_SSAA_SAMPLES
+                uint32_t supported = 1;
+                while (supported < MAX_SSAA_SAMPLES && supported * 2 <= this->AASpp)
+                    supported *= 2;
+                if (supported != this->AASpp)
+                {
+                    std::cout << "[WARNING] SSAA takes a power of two samples up to " << MAX_SSAA_SAMPLES
+                              << ": rendering " << supported << " instead of " << this->AASpp << std::endl;
+                    this->AASpp = supported;
+                }
+            }
+            else if (AAName == "MSAA")
+            {
+                // MSAA always uses the samples of the depth buffer
+                this->AAConfig = AntiAliasConfig::MSAA;
+                this->AASpp = DEPTH_SAMPLES;
             }
         }
 
@@ -291,5 +366,23 @@ bool Loader::LoadObj()
     this->attribs = reader.GetAttrib();
     this->shapes = reader.GetShapes();
 
+    if (this->type != TestType::TRIANGLE && this->type != TestType::TRANSFORM_TEST)
+        BuildLODs();
+    else
+        this->lods.assign(this->shapes.size(), ShapeLOD());
+
+    this->meshes.clear();
+    this->meshes.reserve(this->shapes.size());
+    for (size_t s = 0; s < this->shapes.size(); ++s)
+        this->meshes.push_back(CookMesh(this->shapes[s], this->lods[s], this->attribs));
+
     return true;
 }
+
+void Loader::BuildLODs()
+{
+    this->lods.clear();
+    this->lods.reserve(this->shapes.size());
+    for (auto& shape : this->shapes)
+        this->lods.push_back(BuildShapeLOD(shape, this->attribs, this->lodConfig));
+}
@@ -6,6 +6,8 @@
 #include <optional>
 
 #include "entities.hpp"
+#include "lod.hpp"
+#include "mesh.hpp"
 #include "../thirdparty/tinyobj/tiny_obj_fwd.h"
 
 namespace tinyobj
@@ -60,6 +62,8 @@ public:
             AAStr = "none";
         else if (this->AAConfig == AntiAliasConfig::SSAA)
             AAStr = "SSAA";
+        else if (this->AAConfig == AntiAliasConfig::MSAA)
+            AAStr = "MSAA";
 
         std::string transformStr = "<no transform needed>\n";
         if (this->type != TestType::TRIANGLE)
@@ -69,8 +73,14 @@ public:
             else
             {
                 transformStr = "Transforms:\n";
-                for (auto& transform : this->transforms)
+                for (auto& instances : this->transforms)
                 {
+                    if (instances.size() != 1)
+                    {
+                        transformStr += "| - <" + ToStr(instances.size()) + " instances>\n";
+                        continue;
+                    }
+                    const MeshTransform& transform = instances[0];
                     transformStr += "| - rotation: " + ToStr(transform.rotation) + "\n";
                     transformStr += "|   translation: " + ToStr(transform.translation) + "\n";
                     transformStr += "|   scale: " + ToStr(transform.scale) + "\n";
@@ -80,6 +90,21 @@ public:
                 transformStr += "[WARNING] number of transforms does not match number of shapes\n";
         }
 
+        std::string lodStr = "";
+        if (this->type != TestType::TRIANGLE && this->type != TestType::TRANSFORM_TEST)
+        {
+            if (!this->lodConfig.enabled)
+                lodStr = "LOD: disabled\n";
+            else
+            {
+                size_t levelCount = 0;
+                for (auto& lod : this->lods)
+                    levelCount += lod.levels.size();
+                lodStr = "LOD: " + ToStr(levelCount) + " simplified levels over " + ToStr(this->lods.size()) + " shapes" +
+                    ", threshold " + ToStr(this->lodConfig.threshold) + " px\n";
+            }
+        }
+
         std::string lightStr = "<no light needed>\n";
         if (this->type == TestType::SHADING)
         {
@@ -106,7 +131,7 @@ public:
             "Model: " + this->modelName + "\n" +
             "Output: " + this->outputName + "\n" + 
             ((camera.width == 0) ? "<no camera specified>" : (this->camera.Info())) + "\n" +
-            transformStr + lightStr;
+            transformStr + lodStr + lightStr;
     }
 
     inline const TestType GetType() const { return this->type; }
@@ -132,11 +157,14 @@ public:
 
     inline const Camera& GetCamera() const { return this->camera; }
     inline const std::vector<tinyobj::shape_t>& GetShapes() const { return this->shapes; }
-    inline const std::vector<MeshTransform>& GetTransforms() const { return this->transforms; }
+    inline const std::vector<std::vector<MeshTransform>>& GetTransforms() const { return this->transforms; }
     inline const std::vector<Light>& GetLights() const { return this->lights; }
     inline const float GetSpecularExponent() const { return this->specularExponent; }
     inline const Color GetAmbientColor() const { return this->ambientColor; }
     inline const tinyobj::attrib_t& GetAttribs() const { return this->attribs; }
+    inline const LODConfig& GetLODConfig() const { return this->lodConfig; }
+    inline const std::vector<ShapeLOD>& GetLODs() const { return this->lods; }
+    inline const std::vector<MeshBuffer>& GetMeshes() const { return this->meshes; }
 
 private:
     // configs
@@ -157,7 +185,11 @@ private:
 
     tinyobj::attrib_t attribs;
     std::vector<tinyobj::shape_t> shapes;
-    std::vector<MeshTransform> transforms;
+    std::vector<std::vector<MeshTransform>> transforms;     // instances of each shape
+
+    LODConfig lodConfig;
+    std::vector<ShapeLOD> lods;         // one per shape, built after the obj is loaded
+    std::vector<MeshBuffer> meshes;     // one per shape, cooked from the shape and its LODs
 
     std::vector<Light> lights;
     float specularExponent;
@@ -166,6 +198,7 @@ private:
     // helpers
     bool LoadYaml();
     bool LoadObj();
+    void BuildLODs();
 };
 
 #endif
@@ -0,0 +1,421 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "../thirdparty/glm/glm.hpp"
+
+namespace
+{
+    // Boundary edges are kept in place by planes perpendicular to their face, weighted by this factor
+    constexpr double BOUNDARY_WEIGHT = 100.0;
+
+    // Simplification stops once the error would exceed this fraction of the bounding sphere radius
+    constexpr double MAX_RELATIVE_ERROR = 0.1;
+
+    // Symmetric 4x4 matrix holding the sum of squared distances to a set of planes (Garland & Heckbert)
+    struct Quadric
+    {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {  }
+
+        // plane n.x + d = 0, with n normalized
+        Quadric(glm::dvec3 n, double d, double weight) :
+            a2(weight * n.x * n.x), ab(weight * n.x * n.y), ac(weight * n.x * n.z), ad(weight * n.x * d),
+            b2(weight * n.y * n.y), bc(weight * n.y * n.z), bd(weight * n.y * d),
+            c2(weight * n.z * n.z), cd(weight * n.z * d),
+            d2(weight * d * d) {  }
+
+        Quadric& operator+= (const Quadric& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+            return *this;
+        }
+
+        double Evaluate(const glm::dvec3& p) const
+        {
+            return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+                + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+                + c2 * p.z * p.z + 2 * cd * p.z
+                + d2;
+        }
+
+        // Position minimizing the quadric; false if the system is (nearly) singular
+        bool Optimum(glm::dvec3& p) const
+        {
+            glm::dmat3 A(a2, ab, ac, ab, b2, bc, ac, bc, c2);
+            double scale = std::max({ std::abs(a2), std::abs(b2), std::abs(c2) });
+            double det = glm::determinant(A);
+            if (scale == 0 || std::abs(det) < 1e-6 * scale * scale * scale)
+                return false;
+            p = glm::inverse(A) * glm::dvec3(-ad, -bd, -cd);
+            return true;
+        }
+    };
+
+    struct Face
+    {
+        std::array<uint32_t, 3> v;                  // local vertex ids
+        std::array<tinyobj::index_t, 3> corner;     // source corners, keeping normals and texcoords
+        bool removed;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t u, v;                  // v is merged into u
+        uint32_t stampU, stampV;        // stamps of u and v when the candidate was queued
+        glm::dvec3 target;
+
+        bool operator> (const Collapse& c) const { return cost > c.cost; }
+    };
+
+    inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const tinyobj::shape_t& shape, const tinyobj::attrib_t& attribs);
+
+        // Collapse the cheapest edges until at most `target` faces are left, or no collapse below `maxCost` remains
+        void Reduce(size_t target, double maxCost);
+
+        // Output the current mesh, appending the vertices moved since the last call to `attribs`
+        MeshLOD Emit(tinyobj::attrib_t& attribs);
+
+        inline size_t GetFaceCount() const { return this->faceCount; }
+
+    private:
+        void PushCollapse(uint32_t u, uint32_t v);
+        bool Flips(uint32_t u, uint32_t v, const glm::dvec3& target) const;
+        void Apply(const Collapse& collapse);
+
+        std::vector<glm::dvec3> positions;
+        std::vector<int> globalIndex;       // vertex_index in the attribs, -1 once moved by a collapse
+        std::vector<Quadric> quadrics;
+        std::vector<uint32_t> stamps;
+        std::vector<bool> alive;
+        std::vector<std::vector<uint32_t>> vertexFaces;
+        std::vector<Face> faces;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+        size_t faceCount;
+        double maxError;
+    };
+
+    Simplifier::Simplifier(const tinyobj::shape_t& shape, const tinyobj::attrib_t& attribs) :
+        faceCount(0),
+        maxError(0)
+    {
+        const size_t fv = 3;
+        std::unordered_map<int, uint32_t> localIndex;
+        const std::vector<tinyobj::index_t>& indices = shape.mesh.indices;
+
+        for (size_t offset = 0; offset + fv <= indices.size(); offset += fv)
+        {
+            Face face;
+            face.removed = false;
+            for (size_t i = 0; i < fv; ++i)
+            {
+                const tinyobj::index_t& idx = indices[offset + i];
+                auto [iter, inserted] = localIndex.emplace(idx.vertex_index, static_cast<uint32_t>(this->positions.size()));
+                if (inserted)
+                {
+                    this->positions.emplace_back(
+                        attribs.vertices[3 * size_t(idx.vertex_index) + 0],
+                        attribs.vertices[3 * size_t(idx.vertex_index) + 1],
+                        attribs.vertices[3 * size_t(idx.vertex_index) + 2]);
+                    this->globalIndex.push_back(idx.vertex_index);
+                }
+                face.v[i] = iter->second;
+                face.corner[i] = idx;
+            }
+
+            // degenerate faces carry no surface; drop them up front
+            if (face.v[0] == face.v[1] || face.v[1] == face.v[2] || face.v[2] == face.v[0])
+                continue;
+            this->faces.push_back(face);
+        }
+
+        size_t vertexCount = this->positions.size();
+        this->quadrics.resize(vertexCount);
+        this->stamps.resize(vertexCount, 0);
+        this->alive.resize(vertexCount, true);
+        this->vertexFaces.resize(vertexCount);
+        this->faceCount = this->faces.size();
+
+        // face planes, and the number of faces sharing each edge
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        std::vector<glm::dvec3> faceNormals(this->faces.size(), glm::dvec3(0));
+        for (uint32_t f = 0; f < this->faces.size(); ++f)
+        {
+            const Face& face = this->faces[f];
+            const glm::dvec3& p0 = this->positions[face.v[0]];
+            glm::dvec3 n = glm::cross(this->positions[face.v[1]] - p0, this->positions[face.v[2]] - p0);
+            double len = glm::length(n);
+            if (len > 0)
+            {
+                n /= len;
+                faceNormals[f] = n;
+                Quadric q(n, -glm::dot(n, p0), 1.0);
+                for (uint32_t v : face.v)
+                    this->quadrics[v] += q;
+            }
+            for (size_t i = 0; i < fv; ++i)
+            {
+                ++edgeUse[EdgeKey(face.v[i], face.v[(i + 1) % fv])];
+                this->vertexFaces[face.v[i]].push_back(f);
+            }
+        }
+
+        // pin the open boundaries, otherwise they shrink away first as their collapses look free
+        for (uint32_t f = 0; f < this->faces.size(); ++f)
+        {
+            const Face& face = this->faces[f];
+            for (size_t i = 0; i < fv; ++i)
+            {
+                uint32_t a = face.v[i], b = face.v[(i + 1) % fv];
+                if (edgeUse[EdgeKey(a, b)] != 1)
+                    continue;
+                glm::dvec3 n = glm::cross(this->positions[b] - this->positions[a], faceNormals[f]);
+                double len = glm::length(n);
+                if (len == 0)
+                    continue;
+                n /= len;
+                Quadric q(n, -glm::dot(n, this->positions[a]), BOUNDARY_WEIGHT);
+                this->quadrics[a] += q;
+                this->quadrics[b] += q;
+            }
+        }
+
+        for (auto& [key, count] : edgeUse)
+            this->PushCollapse(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key & 0xffffffffu));
+    }
+
+    void Simplifier::PushCollapse(uint32_t u, uint32_t v)
+    {
+        Quadric q = this->quadrics[u];
+        q += this->quadrics[v];
+
+        // an ill-conditioned optimum can land far away from the edge; only trust it close to the edge
+        glm::dvec3 target;
+        glm::dvec3 midpoint = (this->positions[u] + this->positions[v]) * 0.5;
+        double edgeLength = glm::length(this->positions[u] - this->positions[v]);
+        if (!q.Optimum(target) || glm::length(target - midpoint) > edgeLength)
+        {
+            // flat or linear neighbourhood: pick the best of the endpoints and the midpoint
+            const glm::dvec3 candidates[3] = {
+                this->positions[u], this->positions[v], midpoint
+            };
+            target = candidates[0];
+            for (const glm::dvec3& c : candidates)
+                if (q.Evaluate(c) < q.Evaluate(target))
+                    target = c;
+        }
+
+        double cost = std::max(q.Evaluate(target), 0.0);
+        this->heap.push({ cost, u, v, this->stamps[u], this->stamps[v], target });
+    }
+
+    bool Simplifier::Flips(uint32_t u, uint32_t v, const glm::dvec3& target) const
+    {
+        for (uint32_t f : this->vertexFaces[u])
+        {
+            const Face& face = this->faces[f];
+            if (face.removed || face.v[0] == v || face.v[1] == v || face.v[2] == v)
+                continue;
+
+            std::array<glm::dvec3, 3> p;
+            for (size_t i = 0; i < 3; ++i)
+                p[i] = this->positions[face.v[i]];
+            glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+            for (size_t i = 0; i < 3; ++i)
+                if (face.v[i] == u)
+                    p[i] = target;
+            glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+            if (glm::dot(before, after) <= 0)
+                return true;
+        }
+        return false;
+    }
+
+    void Simplifier::Apply(const Collapse& collapse)
+    {
+        uint32_t u = collapse.u, v = collapse.v;
+
+        this->positions[u] = collapse.target;
+        this->globalIndex[u] = -1;
+        this->quadrics[u] += this->quadrics[v];
+        this->alive[v] = false;
+        ++this->stamps[u];
+        ++this->stamps[v];
+        this->maxError = std::max(this->maxError, collapse.cost);
+
+        for (uint32_t f : this->vertexFaces[v])
+        {
+            Face& face = this->faces[f];
+            if (face.removed)
+                continue;
+            if (face.v[0] == u || face.v[1] == u || face.v[2] == u)
+            {
+                face.removed = true;
+                --this->faceCount;
+                continue;
+            }
+            for (uint32_t& w : face.v)
+                if (w == v)
+                    w = u;
+            this->vertexFaces[u].push_back(f);
+        }
+        this->vertexFaces[v].clear();
+
+        std::vector<uint32_t>& around = this->vertexFaces[u];
+        around.erase(std::remove_if(around.begin(), around.end(),
+            [this](uint32_t f) { return this->faces[f].removed; }), around.end());
+
+        // the quadric of u changed, so every edge leaving u needs a new candidate
+        std::vector<uint32_t> neighbours;
+        for (uint32_t f : around)
+            for (uint32_t w : this->faces[f].v)
+                if (w != u && std::find(neighbours.begin(), neighbours.end(), w) == neighbours.end())
+                    neighbours.push_back(w);
+        for (uint32_t w : neighbours)
+            this->PushCollapse(u, w);
+    }
+
+    void Simplifier::Reduce(size_t target, double maxCost)
+    {
+        while (this->faceCount > target && !this->heap.empty() && this->heap.top().cost <= maxCost)
+        {
+            Collapse collapse = this->heap.top();
+            this->heap.pop();
+
+            if (!this->alive[collapse.u] || !this->alive[collapse.v] ||
+                this->stamps[collapse.u] != collapse.stampU || this->stamps[collapse.v] != collapse.stampV)
+                continue;       // stale candidate
+
+            // rejected candidates are re-queued once a neighbouring collapse changes their endpoints
+            if (this->Flips(collapse.u, collapse.v, collapse.target) || this->Flips(collapse.v, collapse.u, collapse.target))
+                continue;
+
+            this->Apply(collapse);
+        }
+    }
+
+    MeshLOD Simplifier::Emit(tinyobj::attrib_t& attribs)
+    {
+        MeshLOD lod;
+        lod.error = static_cast<float>(std::sqrt(this->maxError));
+        lod.indices.reserve(this->faceCount * 3);
+
+        for (const Face& face : this->faces)
+        {
+            if (face.removed)
+                continue;
+            for (size_t i = 0; i < 3; ++i)
+            {
+                uint32_t local = face.v[i];
+                if (this->globalIndex[local] < 0)
+                {
+                    this->globalIndex[local] = static_cast<int>(attribs.vertices.size() / 3);
+                    attribs.vertices.push_back(static_cast<tinyobj::real_t>(this->positions[local].x));
+                    attribs.vertices.push_back(static_cast<tinyobj::real_t>(this->positions[local].y));
+                    attribs.vertices.push_back(static_cast<tinyobj::real_t>(this->positions[local].z));
+                }
+                tinyobj::index_t idx = face.corner[i];
+                idx.vertex_index = this->globalIndex[local];
+                lod.indices.push_back(idx);
+            }
+        }
+        return lod;
+    }
+}
+
+ShapeLOD BuildShapeLOD(const tinyobj::shape_t& shape, tinyobj::attrib_t& attribs, const LODConfig& config)
+{
+    ShapeLOD lod;
+    const std::vector<tinyobj::index_t>& indices = shape.mesh.indices;
+    if (indices.empty())
+        return lod;
+
+    // bounding sphere around the center of the bounding box
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+    auto position = [&attribs](const tinyobj::index_t& idx)
+    {
+        return glm::vec3(
+            attribs.vertices[3 * size_t(idx.vertex_index) + 0],
+            attribs.vertices[3 * size_t(idx.vertex_index) + 1],
+            attribs.vertices[3 * size_t(idx.vertex_index) + 2]);
+    };
+    for (const tinyobj::index_t& idx : indices)
+    {
+        lo = glm::min(lo, position(idx));
+        hi = glm::max(hi, position(idx));
+    }
+    lod.center = (lo + hi) * 0.5f;
+    for (const tinyobj::index_t& idx : indices)
+        lod.radius = std::max(lod.radius, glm::length(position(idx) - lod.center));
+
+    size_t target = indices.size() / 3;
+    if (!config.enabled || target < config.minFaces)
+        return lod;
+
+    double maxError = MAX_RELATIVE_ERROR * lod.radius;
+    Simplifier simplifier(shape, attribs);
+    for (uint32_t level = 0; level < config.maxLevels; ++level)
+    {
+        target = static_cast<size_t>(target * config.reduction);
+        if (target < 4)
+            break;
+
+        size_t before = simplifier.GetFaceCount();
+        simplifier.Reduce(target, maxError * maxError);
+        if (simplifier.GetFaceCount() >= before)
+            break;
+        lod.levels.push_back(simplifier.Emit(attribs));
+    }
+    return lod;
+}
+
+size_t SelectLOD(const ShapeLOD& lod, const glm::mat4& model, const Camera& camera, uint32_t width, float threshold)
+{
+    if (lod.levels.empty())
+        return 0;
+
+    glm::vec3 center = glm::vec3(model * glm::vec4(lod.center, 1));
+    float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+
+    // distance to the nearest point of the sphere; keep full detail when it reaches the near plane
+    float distance = glm::length(center - camera.pos) - lod.radius * scale;
+    if (distance <= camera.nearClip)
+        return 0;
+
+    // pixels covered by one model space unit at that distance, following the projection in SetProjection
+    float pixelsPerUnit = scale * static_cast<float>(width) * camera.nearClip / (camera.width * distance);
+
+    // the whole shape falls within a pixel: every level looks the same
+    if (lod.radius * pixelsPerUnit < 1.0f)
+        return lod.levels.size();
+
+    size_t level = 0;
+    while (level < lod.levels.size() && lod.levels[level].error * pixelsPerUnit <= threshold)
+        ++level;
+    return level;
+}
@@ -0,0 +1,60 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "../thirdparty/tinyobj/tiny_obj_fwd.h"
+
+// Level-of-detail chains for the loaded shapes, built with quadric error metric edge collapses
+
+struct LODConfig
+{
+    bool enabled = true;
+    uint32_t maxLevels = 4;         // number of simplified levels built per shape
+    float reduction = 0.25f;        // face count ratio between two consecutive levels
+    uint32_t minFaces = 64;         // shapes with fewer faces are never simplified
+    float threshold = 1.0f;         // largest accepted simplification error, in pixels
+};
+
+struct MeshLOD
+{
+    std::vector<tinyobj::index_t> indices;      // 3 per face, referencing the loader attribs
+    float error;                                // model space geometric error w.r.t. the full mesh
+};
+
+struct ShapeLOD
+{
+    // model space bounding sphere of the full mesh
+    glm::vec3 center;
+    float radius;
+
+    // levels[i] is the (i + 1)-th simplification; level 0 is the shape itself and is not stored
+    std::vector<MeshLOD> levels;
+
+    ShapeLOD() : center(0, 0, 0), radius(0) {  }
+};
+
+/**
+ * Build the LOD chain of a single triangulated shape.
+ * Each level is simplified from the previous one, so the whole chain costs a single simplification pass.
+ * @param shape: the shape to simplify
+ * @param attribs: the attributes referenced by the shape. Vertices moved by a collapse are appended to `attribs.vertices`
+ * @param config: the LOD configuration
+ * @return: the bounding sphere and simplified levels of the shape
+ */
+ShapeLOD BuildShapeLOD(const tinyobj::shape_t& shape, tinyobj::attrib_t& attribs, const LODConfig& config);
+
+/**
+ * Select the coarsest level whose error, projected to the screen with the bounding sphere of the shape, stays below the threshold.
+ * @param lod: the LOD chain of the shape
+ * @param model: the model matrix of the shape
+ * @param camera: the camera the shape is viewed from
+ * @param width: horizontal resolution of the output image
+ * @param threshold: largest accepted error in pixels
+ * @return: the selected level; 0 means the full resolution shape
+ */
+size_t SelectLOD(const ShapeLOD& lod, const glm::mat4& model, const Camera& camera, uint32_t width, float threshold);
+
+#endif
@@ -0,0 +1,135 @@
+#include "mesh.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../thirdparty/glm/glm.hpp"
+
+namespace
+{
+    // Append the corners to the level, welding the ones sharing both their position and their normal
+    void AddCorners(MeshLevel& level, const std::vector<tinyobj::index_t>& corners, const tinyobj::attrib_t& attribs)
+    {
+        std::unordered_map<uint64_t, uint32_t> welded;
+        level.indices.reserve(corners.size());
+
+        for (const tinyobj::index_t& idx : corners)
+        {
+            uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(idx.vertex_index)) << 32) |
+                static_cast<uint32_t>(idx.normal_index);
+            auto [iter, inserted] = welded.emplace(key, static_cast<uint32_t>(level.px.size()));
+            if (inserted)
+            {
+                level.px.push_back(attribs.vertices[3 * size_t(idx.vertex_index) + 0]);
+                level.py.push_back(attribs.vertices[3 * size_t(idx.vertex_index) + 1]);
+                level.pz.push_back(attribs.vertices[3 * size_t(idx.vertex_index) + 2]);
+                if (idx.normal_index >= 0)
+                {
+                    level.nx.push_back(attribs.normals[3 * size_t(idx.normal_index) + 0]);
+                    level.ny.push_back(attribs.normals[3 * size_t(idx.normal_index) + 1]);
+                    level.nz.push_back(attribs.normals[3 * size_t(idx.normal_index) + 2]);
+                }
+                else
+                {
+                    level.nx.push_back(0);
+                    level.ny.push_back(0);
+                    level.nz.push_back(0);
+                }
+            }
+            level.indices.push_back(iter->second);
+        }
+    }
+}
+
+void VertexBatch::Resize(size_t count)
+{
+    for (std::vector<float>* array : { &sx, &sy, &sz, &sw, &wx, &wy, &wz, &nx, &ny, &nz, &nw })
+        array->resize(count);
+}
+
+MeshBuffer CookMesh(const tinyobj::shape_t& shape, const ShapeLOD& lod, const tinyobj::attrib_t& attribs)
+{
+    MeshBuffer mesh;
+    mesh.levels.resize(1 + lod.levels.size());
+
+    AddCorners(mesh.levels[0], shape.mesh.indices, attribs);
+    for (size_t i = 0; i < lod.levels.size(); ++i)
+        AddCorners(mesh.levels[i + 1], lod.levels[i].indices, attribs);
+
+    return mesh;
+}
+
+void TransformVertices(const MeshLevel& level, size_t begin, size_t end, const glm::mat4& model, const glm::mat4& viewxprojection,
+    VertexBatch& batch, size_t offset)
+{
+    const size_t count = end - begin;
+
+    const glm::mat4 m = model;
+    const glm::mat4 s = viewxprojection * model;
+    const float* px = level.px.data() + begin;
+    const float* py = level.py.data() + begin;
+    const float* pz = level.pz.data() + begin;
+    const float* nx = level.nx.data() + begin;
+    const float* ny = level.ny.data() + begin;
+    const float* nz = level.nz.data() + begin;
+    float* sx = batch.sx.data() + offset;
+    float* sy = batch.sy.data() + offset;
+    float* sz = batch.sz.data() + offset;
+    float* sw = batch.sw.data() + offset;
+    float* wx = batch.wx.data() + offset;
+    float* wy = batch.wy.data() + offset;
+    float* wz = batch.wz.data() + offset;
+    float* tx = batch.nx.data() + offset;
+    float* ty = batch.ny.data() + offset;
+    float* tz = batch.nz.data() + offset;
+    float* tw = batch.nw.data() + offset;
+
+    // one pass per output group keeps the loops short enough to be vectorized; the sums are grouped
+    //   like glm's matrix-vector product so the results match the per-vertex path bit for bit
+    for (size_t i = 0; i < count; ++i)
+    {
+        sx[i] = (s[0][0] * px[i] + s[1][0] * py[i]) + (s[2][0] * pz[i] + s[3][0]);
+        sy[i] = (s[0][1] * px[i] + s[1][1] * py[i]) + (s[2][1] * pz[i] + s[3][1]);
+        sz[i] = (s[0][2] * px[i] + s[1][2] * py[i]) + (s[2][2] * pz[i] + s[3][2]);
+        sw[i] = (s[0][3] * px[i] + s[1][3] * py[i]) + (s[2][3] * pz[i] + s[3][3]);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        wx[i] = (m[0][0] * px[i] + m[1][0] * py[i]) + (m[2][0] * pz[i] + m[3][0]);
+        wy[i] = (m[0][1] * px[i] + m[1][1] * py[i]) + (m[2][1] * pz[i] + m[3][1]);
+        wz[i] = (m[0][2] * px[i] + m[1][2] * py[i]) + (m[2][2] * pz[i] + m[3][2]);
+    }
+
+    // normals go through the full model matrix with w = 1, as the per-vertex path always did
+    for (size_t i = 0; i < count; ++i)
+    {
+        tx[i] = (m[0][0] * nx[i] + m[1][0] * ny[i]) + (m[2][0] * nz[i] + m[3][0]);
+        ty[i] = (m[0][1] * nx[i] + m[1][1] * ny[i]) + (m[2][1] * nz[i] + m[3][1]);
+        tz[i] = (m[0][2] * nx[i] + m[1][2] * ny[i]) + (m[2][2] * nz[i] + m[3][2]);
+        tw[i] = (m[0][3] * nx[i] + m[1][3] * ny[i]) + (m[2][3] * nz[i] + m[3][3]);
+    }
+}
+
+bool IsSphereVisible(const glm::vec3& center, float radius, const glm::mat4& view, const Camera& camera)
+{
+    // the camera looks down -z in view space
+    glm::vec3 c = glm::vec3(view * glm::vec4(center, 1));
+    float depth = -c.z;
+    if (depth + radius < camera.nearClip || depth - radius > camera.farClip)
+        return false;
+
+    // side planes pass through the eye and the edges of the near plane; normals point outwards
+    float halfWidth = camera.width / 2, halfHeight = camera.height / 2;
+    const glm::vec3 planes[4] = {
+        glm::normalize(glm::vec3( camera.nearClip, 0, halfWidth)),
+        glm::normalize(glm::vec3(-camera.nearClip, 0, halfWidth)),
+        glm::normalize(glm::vec3(0,  camera.nearClip, halfHeight)),
+        glm::normalize(glm::vec3(0, -camera.nearClip, halfHeight)),
+    };
+    for (const glm::vec3& n : planes)
+        if (glm::dot(n, c) > radius)
+            return false;
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entities.hpp"
+#include "lod.hpp"
+#include "../thirdparty/tinyobj/tiny_obj_fwd.h"
+
+// Render-ready copies of the loaded shapes. Every level of detail gets its own compact vertex pool in
+// SoA layout, stored once and shared by all the instances of the shape.
+
+struct MeshLevel
+{
+    std::vector<float> px, py, pz;      // model space positions
+    std::vector<float> nx, ny, nz;      // model space normals; zero where the obj has none
+    std::vector<uint32_t> indices;      // 3 per face, into the arrays above
+
+    inline size_t GetVertexCount() const { return px.size(); }
+    inline size_t GetFaceCount() const { return indices.size() / 3; }
+};
+
+struct MeshBuffer
+{
+    std::vector<MeshLevel> levels;      // levels[0] is the full shape, followed by the levels of its ShapeLOD
+};
+
+// The vertices of one level transformed for one instance, in SoA layout
+struct VertexBatch
+{
+    std::vector<float> sx, sy, sz, sw;  // screen space, before homogenization
+    std::vector<float> wx, wy, wz;      // world space
+    std::vector<float> nx, ny, nz, nw;  // world space normals
+
+    void Resize(size_t count);
+
+    inline glm::vec4 GetScreen(uint32_t i) const { return glm::vec4(sx[i], sy[i], sz[i], sw[i]); }
+    inline glm::vec4 GetWorld(uint32_t i) const { return glm::vec4(wx[i], wy[i], wz[i], 1); }
+    inline glm::vec4 GetNormal(uint32_t i) const { return glm::vec4(nx[i], ny[i], nz[i], nw[i]); }
+};
+
+/**
+ * Build the vertex pools of a shape and of each of its levels of detail.
+ * Vertices are welded on their (position, normal) index pair, so every corner keeps its own normal.
+ * @param shape: the triangulated shape
+ * @param lod: the LOD chain built for the shape; may hold no level
+ * @param attribs: the attributes referenced by the shape and its LOD chain
+ */
+MeshBuffer CookMesh(const tinyobj::shape_t& shape, const ShapeLOD& lod, const tinyobj::attrib_t& attribs);
+
+/**
+ * Transform a range of the vertices of a level for one instance. Runs as straight loops over the SoA arrays so the
+ * compiler can vectorize them.
+ * @param level: the vertices to transform
+ * @param begin: first vertex of the range
+ * @param end: one past the last vertex of the range
+ * @param model: the model matrix of the instance
+ * @param viewxprojection: the matrix from world space to screen space
+ * @param batch: receives the transformed vertices; must hold at least `offset + end - begin` vertices
+ * @param offset: where vertex `begin` is stored in the batch
+ */
+void TransformVertices(const MeshLevel& level, size_t begin, size_t end, const glm::mat4& model, const glm::mat4& viewxprojection,
+    VertexBatch& batch, size_t offset);
+
+/**
+ * Check whether a world space sphere overlaps the view frustum of the camera.
+ * @param center: center of the sphere in world space
+ * @param radius: radius of the sphere
+ * @param view: the view matrix of the camera
+ * @param camera: the camera, providing the clip planes and the extent of the near plane
+ */
+bool IsSphereVisible(const glm::vec3& center, float radius, const glm::mat4& view, const Camera& camera);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Number of worker threads used by the parallel stages, including the calling thread
+inline size_t GetWorkerCount()
+{
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+/**
+ * Run `body(begin, end)` over [0, count) split into chunks of `grain` items, spread over all the workers.
+ * Chunks are handed out dynamically, so `body` must only write to the outputs of its own range.
+ * Small ranges run on the calling thread.
+ * @param count: number of items
+ * @param grain: number of items per chunk
+ * @param body: callable taking the (begin, end) range of a chunk
+ */
+template<typename Body>
+void ParallelFor(size_t count, size_t grain, const Body& body)
+{
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (count + grain - 1) / grain;
+    size_t workers = std::min(GetWorkerCount(), chunks);
+    if (workers <= 1)
+    {
+        if (count > 0)
+            body(size_t(0), count);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    auto work = [&]()
+    {
+        for (size_t chunk = next++; chunk < chunks; chunk = next++)
+            body(chunk * grain, std::min(count, (chunk + 1) * grain));
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t i = 1; i < workers; ++i)
+        threads.emplace_back(work);
+    work();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+#endif
@@ -0,0 +1,218 @@
+#include "raster_kernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "../thirdparty/glm/gtx/norm.hpp"
+
+namespace
+{
+    // Edge functions of a screen space triangle, set up once per triangle
+    struct TriangleSetup
+    {
+        // edge i runs from vertex i to vertex i + 1; its function is a[i] * (x - ox[i]) + b[i] * (y - oy[i]),
+        //   positive inside the triangle whatever its winding
+        float a[3], b[3], ox[3], oy[3];
+        bool topLeft[3];                // edges owning the samples exactly on them, so shared edges are drawn once
+        float invArea;                  // 1 / (sum of the three edge functions)
+        uint32_t xmin, xmax, ymin, ymax;
+
+        // false for degenerate triangles and triangles entirely off screen
+        bool Init(const Triangle& trig, uint32_t width, uint32_t height)
+        {
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                const glm::vec4& v0 = trig.pos[i];
+                const glm::vec4& v1 = trig.pos[(i + 1) % 3];
+                a[i] = v0.y - v1.y;
+                b[i] = v1.x - v0.x;
+                ox[i] = v0.x;
+                oy[i] = v0.y;
+            }
+            float area = a[0] * (trig.pos[2].x - ox[0]) + b[0] * (trig.pos[2].y - oy[0]);
+            if (!(area != 0))
+                return false;
+            if (area < 0)
+            {
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    a[i] = -a[i];
+                    b[i] = -b[i];
+                }
+                area = -area;
+            }
+            invArea = 1.0f / area;
+            for (uint32_t i = 0; i < 3; ++i)
+                topLeft[i] = a[i] > 0 || (a[i] == 0 && b[i] < 0);
+
+            float lx = std::min({ trig.pos[0].x, trig.pos[1].x, trig.pos[2].x });
+            float hx = std::max({ trig.pos[0].x, trig.pos[1].x, trig.pos[2].x });
+            float ly = std::min({ trig.pos[0].y, trig.pos[1].y, trig.pos[2].y });
+            float hy = std::max({ trig.pos[0].y, trig.pos[1].y, trig.pos[2].y });
+            if (!(hx >= 0 && hy >= 0 && lx < static_cast<float>(width) && ly < static_cast<float>(height)))
+                return false;
+            xmin = static_cast<uint32_t>(std::max(lx, 0.f));
+            ymin = static_cast<uint32_t>(std::max(ly, 0.f));
+            xmax = static_cast<uint32_t>(std::min(hx, static_cast<float>(width - 1)));
+            ymax = static_cast<uint32_t>(std::min(hy, static_cast<float>(height - 1)));
+            return true;
+        }
+
+        inline float Edge(uint32_t i, float x, float y) const { return a[i] * (x - ox[i]) + b[i] * (y - oy[i]); }
+
+        inline bool Inside(float e0, float e1, float e2) const
+        {
+            return (e0 > 0 || (e0 == 0 && topLeft[0])) &
+                (e1 > 0 || (e1 == 0 && topLeft[1])) &
+                (e2 > 0 || (e2 == 0 && topLeft[2]));
+        }
+    };
+
+    Color Shade(const RasterTarget& target, const Triangle& original, const glm::vec3& bary)
+    {
+        // Interpolate position and normal
+        glm::vec3 interpolatedPos = bary.x * glm::vec3(original.pos[0]) + bary.y * glm::vec3(original.pos[1]) + bary.z * glm::vec3(original.pos[2]);
+        glm::vec3 normal = bary.x * original.normal[0] + bary.y * original.normal[1] + bary.z * original.normal[2];
+        normal = glm::normalize(normal);
+
+        Color result = target.ambient;
+        glm::vec3 v = glm::normalize(target.cameraPos - interpolatedPos);
+        for (const Light& light : *target.lights)
+        {
+            glm::vec3 l = glm::normalize(light.pos - interpolatedPos);
+            glm::vec3 h = glm::normalize(l + v);
+            float r2 = glm::length2(light.pos - interpolatedPos);
+
+            float NdotL = std::max(glm::dot(normal, l), 0.0f);
+            float NdotH = std::max(glm::dot(normal, h), 0.0f);
+
+            Color diffuse = light.color * (light.intensity / r2) * NdotL;
+            Color specular = light.color * (light.intensity / r2) * glm::pow(NdotH, target.specularExponent);
+
+            result = result + diffuse + specular;
+        }
+        return result;
+    }
+
+    template<RasterAttributes ATTR, AntiAliasConfig AA, uint32_t SPP>
+    void RasterTriangle(const RasterTarget& target, const Triangle& transformed, const Triangle& original)
+    {
+        // only FLAT has its own samples; the depth buffer samples must match the pattern used to write them
+        constexpr bool USE_DEPTH = ATTR != RasterAttributes::FLAT || AA == AntiAliasConfig::MSAA;
+        static_assert(!USE_DEPTH || SPP == DEPTH_SAMPLES, "depth buffer kernels must use the depth buffer samples");
+        static_assert(ATTR != RasterAttributes::SHADED || SPP <= 32, "the samples a SHADED kernel owns fit a 32 bit mask");
+        static constexpr SamplePattern<SPP> pattern;
+
+        TriangleSetup setup;
+        if (!setup.Init(transformed, target.width, target.height))
+            return;
+
+        DepthPlane plane{ 0, 0, 0 };
+        if constexpr (USE_DEPTH)
+            plane = DepthPlane::FromTriangle(transformed);
+
+        // per sample offsets of the edge functions from their value at the pixel corner
+        float offset[3][SPP];
+        for (uint32_t i = 0; i < 3; ++i)
+            for (uint32_t s = 0; s < SPP; ++s)
+                offset[i][s] = setup.a[i] * pattern.x[s] + setup.b[i] * pattern.y[s];
+
+        for (uint32_t y = setup.ymin; y <= setup.ymax; ++y)
+        {
+            const float fy = static_cast<float>(y);
+            for (uint32_t x = setup.xmin; x <= setup.xmax; ++x)
+            {
+                const float fx = static_cast<float>(x);
+                const float e0 = setup.Edge(0, fx, fy), e1 = setup.Edge(1, fx, fy), e2 = setup.Edge(2, fx, fy);
+
+                uint32_t covered = 0;
+                uint32_t owned = 0;             // SHADED: mask of the samples whose depth is ours
+                for (uint32_t s = 0; s < SPP; ++s)
+                {
+                    if (!setup.Inside(e0 + offset[0][s], e1 + offset[1][s], e2 + offset[2][s]))
+                        continue;
+
+                    if constexpr (USE_DEPTH)
+                    {
+                        // same expression as DepthBuffer::GetSamplePosition, so every pass sees the same depth
+                        float depth = plane.Evaluate(fx + pattern.x[s], fy + pattern.y[s]);
+                        if constexpr (ATTR == RasterAttributes::SHADED)
+                        {
+                            // the depth pass already resolved visibility: the sample is ours if it holds our depth
+                            if (!(depth >= target.depth->Get(x, y, s)))
+                                continue;
+                            owned |= 1u << s;
+                        }
+                        else if (target.depth->Test(x, y, s, depth))
+                            target.depth->Set(x, y, s, depth, plane);
+                    }
+                    ++covered;
+                }
+
+                if constexpr (ATTR == RasterAttributes::DEPTH)
+                    continue;
+                if (covered == 0)
+                    continue;
+
+                if constexpr (ATTR == RasterAttributes::FLAT)
+                {
+                    const float coverage = static_cast<float>(covered) / static_cast<float>(SPP);
+                    if constexpr (SPP == 1)
+                        target.image->Set(x, y, target.color);
+                    else
+                        target.image->Set(x, y, target.color * coverage);
+                }
+                else
+                {
+                    // shade once per pixel, at its center
+                    const float cx = fx + 0.5f, cy = fy + 0.5f;
+                    glm::vec3 bary(setup.Edge(1, cx, cy), setup.Edge(2, cx, cy), setup.Edge(0, cx, cy));
+                    bary *= setup.invArea;
+                    // the samples take the color of the triangle they belong to, and the pixel is resolved from
+                    //   them once every triangle is drawn; a sample two triangles tie on keeps a single color
+                    Color color = Shade(target, original, bary);
+                    std::optional<Color>* samples = target.sampleColors->data() + (static_cast<size_t>(y) * target.width + x) * SPP;
+                    for (uint32_t s = 0; s < SPP; ++s)
+                        if (owned & (1u << s))
+                            samples[s] = color;
+                }
+            }
+        }
+    }
+
+    // SSAA kernels indexed by log2 of the sample count
+    template<size_t... LOG>
+    constexpr std::array<RasterKernel, sizeof...(LOG)> MakeSSAATable(std::index_sequence<LOG...>)
+    {
+        return { &RasterTriangle<RasterAttributes::FLAT, AntiAliasConfig::SSAA, (1u << LOG)>... };
+    }
+
+    constexpr size_t SSAA_LEVELS = 7;
+    static_assert((1u << (SSAA_LEVELS - 1)) == MAX_SSAA_SAMPLES, "one SSAA kernel per power of two up to the maximum");
+    constexpr std::array<RasterKernel, SSAA_LEVELS> SSAA_KERNELS = MakeSSAATable(std::make_index_sequence<SSAA_LEVELS>());
+}
+
+RasterKernel SelectRasterKernel(RasterAttributes attributes, AntiAliasConfig config, uint32_t spp)
+{
+    // the depth buffer is built with the DEPTH_SAMPLES positions of MSAA, so the kernels reading and writing it
+    //   take those samples whatever anti-aliasing the config asks for
+    if (attributes == RasterAttributes::DEPTH)
+        return &RasterTriangle<RasterAttributes::DEPTH, AntiAliasConfig::MSAA, DEPTH_SAMPLES>;
+    if (attributes == RasterAttributes::SHADED)
+        return &RasterTriangle<RasterAttributes::SHADED, AntiAliasConfig::MSAA, DEPTH_SAMPLES>;
+
+    if (config == AntiAliasConfig::MSAA)
+        return &RasterTriangle<RasterAttributes::FLAT, AntiAliasConfig::MSAA, DEPTH_SAMPLES>;
+    if (config == AntiAliasConfig::SSAA)
+    {
+        // the loader has already rounded the count to a power of two, with a warning
+        size_t level = 0;
+        while (level + 1 < SSAA_LEVELS && (2u << level) <= spp)
+            ++level;
+        return SSAA_KERNELS[level];
+    }
+    return &RasterTriangle<RasterAttributes::FLAT, AntiAliasConfig::NONE, 1>;
+}
@@ -0,0 +1,96 @@
+#ifndef RASTER_KERNELS_H
+#define RASTER_KERNELS_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "depthbuffer.hpp"
+#include "entities.hpp"
+#include "image.hpp"
+#include "loader.hpp"
+
+// Triangle raster kernels, specialized at compile time on the anti-aliasing mode, the sample count and the
+// attributes written. A kernel is picked once per draw through `SelectRasterKernel`; inside it the sample loops
+// have a constant trip count and the attribute choice is resolved by `if constexpr`, so there is no per pixel
+// branching on the configuration and no allocation.
+
+enum class RasterAttributes
+{
+    DEPTH,          // depth pass: keep the closest depth of every sample
+    FLAT,           // a constant color scaled by the covered fraction of each pixel
+    SHADED          // Blinn-Phong shading of the samples that won the depth pass
+};
+
+// Number of samples per pixel kept by the depth buffer; MSAA and the shading tasks always use this many
+constexpr uint32_t DEPTH_SAMPLES = 4;
+
+// Largest sample count SSAA is specialized for. SSAA is specialized for powers of two only: the loader clamps larger
+//   counts to this one and rounds the others down, with a warning
+constexpr uint32_t MAX_SSAA_SAMPLES = 64;
+
+/**
+ * Fixed stratified sample positions inside a pixel: the 2D Hammersley set of `SPP` points, shifted to the center
+ * of their strata. A single sample sits on the pixel center.
+ */
+template<uint32_t SPP>
+struct SamplePattern
+{
+    std::array<float, SPP> x, y;
+
+    constexpr SamplePattern() : x(), y()
+    {
+        for (uint32_t i = 0; i < SPP; ++i)
+        {
+            // radical inverse of i in base 2
+            float inverse = 0, digit = 0.5f;
+            for (uint32_t bits = i; bits != 0; bits >>= 1, digit *= 0.5f)
+                if (bits & 1)
+                    inverse += digit;
+            x[i] = (static_cast<float>(i) + 0.5f) / static_cast<float>(SPP);
+            y[i] = inverse + 0.5f / static_cast<float>(SPP);
+        }
+    }
+};
+
+// The sample positions of a pattern, in the layout `DepthBuffer` takes
+template<uint32_t SPP>
+std::vector<glm::vec2> GetSampleOffsets()
+{
+    constexpr SamplePattern<SPP> pattern;
+    std::vector<glm::vec2> offsets(SPP);
+    for (uint32_t i = 0; i < SPP; ++i)
+        offsets[i] = glm::vec2(pattern.x[i], pattern.y[i]);
+    return offsets;
+}
+
+// Everything a kernel writes to or reads from, gathered once per draw
+struct RasterTarget
+{
+    uint32_t width, height;
+    Image* image;                               // unused by DEPTH
+    DepthBuffer* depth;                         // unused by FLAT without MSAA
+    Color color;                                // FLAT only
+
+    // SHADED only
+    std::vector<std::optional<Color>>* sampleColors;    // per depth buffer sample, row by row; see Rasterizer::ResolveShading
+    const std::vector<Light>* lights;
+    Color ambient;
+    float specularExponent;
+    glm::vec3 cameraPos;
+};
+
+using RasterKernel = void (*)(const RasterTarget& target, const Triangle& transformed, const Triangle& original);
+
+/**
+ * Pick the kernel for a draw.
+ * @param attributes: what the kernel writes
+ * @param config: the anti-aliasing mode; only used by FLAT, the other sets always use the DEPTH_SAMPLES of the depth
+ *   buffer, since that is how many it stores per pixel
+ * @param spp: samples per pixel for SSAA, a power of two in [1, MAX_SSAA_SAMPLES]; other counts are rounded down to
+ *   one, as `Loader` does when it reads them
+ */
+RasterKernel SelectRasterKernel(RasterAttributes attributes, AntiAliasConfig config, uint32_t spp);
+
+#endif
@@ -20,40 +20,18 @@
 Rasterizer::Rasterizer(Loader& loader) : 
     loader(loader),
     model(),
+    instanceStart{ 0 },
     view(glm::mat4(1.f)),  
     projection(glm::mat4(1.f)),  
     screenspace(glm::mat4(1.f)),
-    ZBuffer(loader.GetWidth(), loader.GetHeight())
+    ZBuffer(loader.GetWidth(), loader.GetHeight(), Rasterizer::msaaOffsets, Rasterizer::zBufferDefault)
 {   
-    for (size_t i = 0; i != loader.GetHeight(); ++i)
-        for (size_t j = 0; j != loader.GetWidth(); ++j)
-            ZBuffer.Set(j, i, -1.f);
 }
 
 void Rasterizer::DrawPrimitiveRaw(Image &image, Triangle trig, AntiAliasConfig config, uint32_t spp)
 {
-    uint32_t xmax = 0, xmin = UINT32_MAX;
-    uint32_t ymax = 0, ymin = UINT32_MAX;
-    const std::array<glm::vec4, 3>& vertices = trig.pos;
-
-    std::array<glm::vec3, 3> trimmedPos;
-    for (size_t ind = 0; ind != 3; ++ind)
-    {
-        const glm::vec4& v = vertices[ind];
-        if (v.x > xmax)
-            xmax = v.x;
-        if (v.x < xmin)
-            xmin = v.x;
-        if (v.y > ymax)
-            ymax = v.y;
-        if (v.y < ymin)
-            ymin = v.y;
-        trimmedPos[ind] = glm::vec3(v.x, v.y, 0);
-    }
-    
-    for (uint32_t x = xmin; x <= xmax; ++x)
-        for (uint32_t y = ymin; y <= ymax; ++y)
-            this->DrawPixel(x, y, trig, config, spp, image, Color::White);
+    RasterKernel kernel = SelectRasterKernel(RasterAttributes::FLAT, config, spp);
+    kernel(this->GetRasterTarget(&image, Color::White), trig, trig);
 }
 
 void Rasterizer::AddModel(MeshTransform transform)
@@ -62,61 +40,85 @@ void Rasterizer::AddModel(MeshTransform transform)
     this->AddModel(transform, rotation);
 }
 
-void Rasterizer::InitZBuffer(ImageGrey& ZBuffer)
+void Rasterizer::AddInstances(const std::vector<MeshTransform>& transforms)
 {
-    for (size_t i = 0; i != this->loader.GetHeight(); ++i)
-        for (size_t j = 0; j != this->loader.GetWidth(); ++j)
-            ZBuffer.Set(j, i, Rasterizer::zBufferDefault);
+    this->model.reserve(this->model.size() + transforms.size());
+    for (const MeshTransform& transform : transforms)
+        this->AddModel(transform);
+    this->instanceStart.push_back(this->model.size());
 }
 
-void Rasterizer::DrawPrimitiveDepth(Triangle transformed, Triangle original, ImageGrey& ZBuffer)
+void Rasterizer::InitZBuffer(DepthBuffer& ZBuffer)
 {
-    uint32_t xmax = 0, xmin = UINT32_MAX;
-    uint32_t ymax = 0, ymin = UINT32_MAX;
-    const std::array<glm::vec4, 3>& vertices = transformed.pos;
-
-    std::array<glm::vec3, 3> trimmedPos;
-    for (size_t ind = 0; ind != 3; ++ind)
-    {
-        const glm::vec4& v = vertices[ind];
-        if (v.x > xmax)
-            xmax = v.x;
-        if (v.x < xmin)
-            xmin = v.x;
-        if (v.y > ymax)
-            ymax = v.y;
-        if (v.y < ymin)
-            ymin = v.y;
-        trimmedPos[ind] = glm::vec3(v.x, v.y, 0);
-    }
-
-    for (uint32_t x = xmin; x <= xmax; ++x)
-        for (uint32_t y = ymin; y <= ymax; ++y)
-            this->UpdateDepthAtPixel(x, y, original, transformed, ZBuffer);
+    // only the tile headers are reset
+    ZBuffer.Clear();
+}
+
+void Rasterizer::ResolveDepth(const DepthBuffer& ZBuffer, ImageGrey& image)
+{
+    // reversed-Z depth nearClip / d is affine in 1 / d, and so is the z of the projection: map the clip planes to 1 and -1
+    const Camera& camera = this->loader.GetCamera();
+    float farDepth = camera.nearClip / camera.farClip;
+    float scale = 2.0f / (1.0f - farDepth);
+
+    for (uint32_t y = 0; y != image.GetHeight(); ++y)
+        for (uint32_t x = 0; x != image.GetWidth(); ++x)
+            image.Set(x, y, (ZBuffer.GetPixel(x, y) - farDepth) * scale - 1.0f);
+}
+
+void Rasterizer::DrawPrimitiveDepth(Triangle transformed, Triangle original, DepthBuffer& ZBuffer)
+{
+    RasterTarget target = this->GetRasterTarget(nullptr, Color::White);
+    target.depth = &ZBuffer;
+    RasterKernel kernel = SelectRasterKernel(RasterAttributes::DEPTH, this->loader.GetAntiAliasConfig(), this->loader.GetSpp());
+    kernel(target, transformed, original);
+}
+
+void Rasterizer::InitSampleColors()
+{
+    this->sampleColors.assign(static_cast<size_t>(this->loader.GetWidth()) * this->loader.GetHeight() * DEPTH_SAMPLES, std::nullopt);
 }
 
 void Rasterizer::DrawPrimitiveShaded(Triangle transformed, Triangle original, Image& image)
 {
-    uint32_t xmax = 0, xmin = UINT32_MAX;
-    uint32_t ymax = 0, ymin = UINT32_MAX;
-    const std::array<glm::vec4, 3>& vertices = transformed.pos;
-
-    std::array<glm::vec3, 3> trimmedPos;
-    for (size_t ind = 0; ind != 3; ++ind)
-    {
-        const glm::vec4& v = vertices[ind];
-        if (v.x > xmax)
-            xmax = v.x;
-        if (v.x < xmin)
-            xmin = v.x;
-        if (v.y > ymax)
-            ymax = v.y;
-        if (v.y < ymin)
-            ymin = v.y;
-        trimmedPos[ind] = glm::vec3(v.x, v.y, 0);
-    }
-
-    for (uint32_t x = xmin; x <= xmax; ++x)
-        for (uint32_t y = ymin; y <= ymax; ++y)
-            this->ShadeAtPixel(x, y, original, transformed, image);
+    RasterKernel kernel = SelectRasterKernel(RasterAttributes::SHADED, this->loader.GetAntiAliasConfig(), this->loader.GetSpp());
+    kernel(this->GetRasterTarget(&image, Color::White), transformed, original);
+}
+
+void Rasterizer::ResolveShading(Image& image)
+{
+    for (uint32_t y = 0; y != image.GetHeight(); ++y)
+        for (uint32_t x = 0; x != image.GetWidth(); ++x)
+        {
+            const std::optional<Color>* samples = this->sampleColors.data() + (static_cast<size_t>(y) * image.GetWidth() + x) * DEPTH_SAMPLES;
+            float r = 0, g = 0, b = 0;
+            bool owned = false;
+            for (uint32_t s = 0; s < DEPTH_SAMPLES; ++s)
+            {
+                if (!samples[s])
+                    continue;
+                r += samples[s]->r;
+                g += samples[s]->g;
+                b += samples[s]->b;
+                owned = true;
+            }
+            if (owned)
+                image.Set(x, y, Color(r / DEPTH_SAMPLES, g / DEPTH_SAMPLES, b / DEPTH_SAMPLES, 255));
+        }
+}
+
+RasterTarget Rasterizer::GetRasterTarget(Image* image, Color color)
+{
+    RasterTarget target;
+    target.width = this->loader.GetWidth();
+    target.height = this->loader.GetHeight();
+    target.image = image;
+    target.depth = &this->ZBuffer;
+    target.color = color;
+    target.sampleColors = &this->sampleColors;
+    target.lights = &this->loader.GetLights();
+    target.ambient = this->loader.GetAmbientColor();
+    target.specularExponent = this->loader.GetSpecularExponent();
+    target.cameraPos = this->loader.GetCamera().pos;
+    return target;
 }
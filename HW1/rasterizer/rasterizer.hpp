@@ -5,8 +5,11 @@
 #include "image.hpp"
 #include "loader.hpp"
 #include <cstdint>
+#include <optional>
+#include <vector>
 
-#include "ZBufferSamples.hpp"
+#include "depthbuffer.hpp"
+#include "raster_kernels.hpp"
 
 class Rasterizer
 {
@@ -21,31 +24,33 @@ public:
     // Add a model to the rasterizer. Provide rotation part of the transformation, and dispatch to the impl version
     void AddModel(MeshTransform transform);
 
+    // Add all the instances of the next shape; the model matrices of shape s end up in [instanceStart[s], instanceStart[s + 1])
+    void AddInstances(const std::vector<MeshTransform>& transforms);
+
 
     // Initialize the ZBuffer with the default value specified in impl
-    void InitZBuffer(ImageGrey& ZBuffer);
+    void InitZBuffer(DepthBuffer& ZBuffer);
 
     // Render the depth information of a single triangle.
-    void DrawPrimitiveDepth(Triangle transformed, Triangle original, ImageGrey& ZBuffer);
+    void DrawPrimitiveDepth(Triangle transformed, Triangle original, DepthBuffer& ZBuffer);
+
+    // Write the closest depth of every pixel to a greyscale image, mapped back to the [-1, 1] range of the projection
+    void ResolveDepth(const DepthBuffer& ZBuffer, ImageGrey& image);
 
-    // Render a single triangle, with blinn-phong shading
+    // Forget the sample colors of the last frame; shading writes them, and ResolveShading turns them into pixels
+    void InitSampleColors();
+
+    // Render a single triangle, with blinn-phong shading, into the samples it owns once the depth of every triangle
+    //   is in the ZBuffer
     void DrawPrimitiveShaded(Triangle transformed, Triangle original, Image& image);
 
-    // rasterizer_impl.cpp
+    // Write the average color of the samples of every pixel some triangle owns to the image; the others count as black
+    void ResolveShading(Image& image);
 
-    /** 
-     * Given a single pixel in the screen space with the triangle in which the pixel is considered, determine the output color that should be rendered for the pixel.
-     * This function will be called for every pixel in the bounding box of the triangle.
-     * @param x: x coordinate of the pixel
-     * @param y: y coordinate of the pixel
-     * @param trig: the triangle in which the pixel is considered; see class `Triangle` in `entities.hpp`
-     * @param config: the anti-aliasing configuration, which can be either `NONE` or `SSAA`
-     * @param spp: the number of samples per pixel. Only useful if config is set to `SSAA`
-     * @param image: the image to render the pixel on. See class `Image` in `image.hpp` for APIs of read/write operations
-     * @param color: the color to render the pixel with, if the pixel is completely inside the triangle
-     */
-    void DrawPixel(uint32_t x, uint32_t y, Triangle trig, AntiAliasConfig config, uint32_t spp, Image& image, Color color);
+    // Gather the buffers and the shading inputs a raster kernel needs; see `raster_kernels.hpp`. `image` may be null for depth only draws
+    RasterTarget GetRasterTarget(Image* image, Color color);
 
+    // rasterizer_impl.cpp
 
     /**
      * Add the corresponding model transformation to the rasterizer. 
@@ -77,37 +82,19 @@ public:
      * @return: the barycentric coordinates of the position with respect to the triangle
      */
     glm::vec3 BarycentricCoordinate(glm::vec2 pos, Triangle trig);
-
-    /**
-     * Update the depth information at a single pixel in the ZBuffer. This function will be called for every pixel in the bounding box of the triangle.
-     * @param x: x coordinate of the pixel
-     * @param y: y coordinate of the pixel
-     * @param original: the original triangle in the model space (before MVP transformation)
-     * @param transformed: the transformed triangle in the screen space (after MVP transformation)
-     * @param ZBuffer: the ZBuffer to update the depth information in. See spec, or class `Image` in `image.hpp` for APIs of read/write operations
-     */
-    void UpdateDepthAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, ImageGrey& ZBuffer);
-
-    /**
-     * Shade the pixel at the given position, using Blinn-Phong shading model. This function will be called for every pixel in the bounding box of the triangle.
-     * @param x: x coordinate of the pixel
-     * @param y: y coordinate of the pixel
-     * @param original: the original triangle in the model space (before MVP transformation)
-     * @param transformed: the transformed triangle in the screen space (after MVP transformation)
-     * @param image: the image to render the pixel on. See spec, or class `Image` in `image.hpp` for APIs of read/write operations
-     */
-    void ShadeAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, Image& image);
-
 public:
     // Configs
     Loader& loader;
     std::vector<glm::mat4x4> model;
+    std::vector<size_t> instanceStart;
     glm::mat4x4 view;
     glm::mat4x4 projection;
     glm::mat4x4 screenspace;
 
-    // Buffers
-    ImageGrey ZBuffer;
+    // Buffers; depth is multi-sampled with the MSAA pattern and stored reversed-Z, see `depthbuffer.hpp`
+    DepthBuffer ZBuffer;
+    // the color of every ZBuffer sample, set by the triangle owning it; empty until shaded
+    std::vector<std::optional<Color>> sampleColors;
 
     // Configurations 
     /** 
@@ -115,8 +102,10 @@ public:
      */
     static float zBufferDefault;
 
-    // Add ZBufferSamples for MSAA
-    ZBufferSamples ZBufferSamples;
+    /**
+     * Sample positions inside a pixel used for MSAA and for the depth buffer.
+     */
+    static const std::vector<glm::vec2> msaaOffsets;
 };
 
 #endif
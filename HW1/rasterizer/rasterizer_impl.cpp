@@ -13,34 +13,8 @@
 #include "../thirdparty/glm/gtc/type_ptr.hpp"
 #include "../thirdparty/glm/gtx/quaternion.hpp"
 
-// Define sample offsets for MSAA
-const std::vector<glm::vec2> MSAA_SAMPLE_OFFSETS = {
-    {0.25f, 0.25f},
-    {0.75f, 0.25f},
-    {0.25f, 0.75f},
-    {0.75f, 0.75f}
-};
-
-// Function to check if a point is inside a triangle
-bool IsPointInsideTriangle(const glm::vec3& point, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
-{
-    glm::vec3 edge0 = v1 - v0;
-    glm::vec3 edge1 = v2 - v1;
-    glm::vec3 edge2 = v0 - v2;
-
-    glm::vec3 c0 = point - v0;
-    glm::vec3 c1 = point - v1;
-    glm::vec3 c2 = point - v2;
-
-    glm::vec3 cross0 = glm::cross(edge0, c0);
-    glm::vec3 cross1 = glm::cross(edge1, c1);
-    glm::vec3 cross2 = glm::cross(edge2, c2);
-
-    if (glm::dot(cross0, cross1) >= 0 && glm::dot(cross0, cross2) >= 0) {
-        return true;
-    }
-    return false;
-}
+// Sample offsets for MSAA and the depth buffer; the raster kernels use the same fixed pattern
+const std::vector<glm::vec2> Rasterizer::msaaOffsets = GetSampleOffsets<DEPTH_SAMPLES>();
 
 // Function to compute barycentric coordinates
 glm::vec3 Rasterizer::BarycentricCoordinate(glm::vec2 pos, Triangle trig)
@@ -67,70 +41,6 @@ glm::vec3 Rasterizer::BarycentricCoordinate(glm::vec2 pos, Triangle trig)
     return glm::vec3(u, v, w);
 }
 
-// Implement MSAA in DrawPixel function
-void Rasterizer::DrawPixel(uint32_t x, uint32_t y, Triangle trig, AntiAliasConfig config, uint32_t spp, Image& image, Color color)
-{
-    if (config == AntiAliasConfig::NONE)
-    {
-        glm::vec3 pixel_center(x + 0.5f, y + 0.5f, 0.0f);
-        if (IsPointInsideTriangle(pixel_center, trig.pos[0], trig.pos[1], trig.pos[2]))
-        {
-            image.Set(x, y, color);
-        }
-    }
-    else if (config == AntiAliasConfig::SSAA)
-    {
-        uint32_t sample_count = 0;
-        for (uint32_t i = 0; i < spp; ++i)
-        {
-            float sample_x = static_cast<float>(x) + static_cast<float>(rand()) / RAND_MAX;
-            float sample_y = static_cast<float>(y) + static_cast<float>(rand()) / RAND_MAX;
-            glm::vec3 sample_point(sample_x, sample_y, 0.0f);
-
-            if (IsPointInsideTriangle(sample_point, trig.pos[0], trig.pos[1], trig.pos[2]))
-            {
-                ++sample_count;
-            }
-        }
-
-        float coverage = static_cast<float>(sample_count) / static_cast<float>(spp);
-        Color final_color = color * coverage;
-        image.Set(x, y, final_color);
-    }
-    else if (config == AntiAliasConfig::MSAA)
-    {
-        uint32_t covered_samples = 0;
-        std::vector<float> sample_depths(spp, std::numeric_limits<float>::infinity());
-
-        for (uint32_t i = 0; i < spp; ++i)
-        {
-            float sample_x = static_cast<float>(x) + MSAA_SAMPLE_OFFSETS[i % MSAA_SAMPLE_OFFSETS.size()].x;
-            float sample_y = static_cast<float>(y) + MSAA_SAMPLE_OFFSETS[i % MSAA_SAMPLE_OFFSETS.size()].y;
-            glm::vec3 sample_point(sample_x, sample_y, 0.0f);
-
-            if (IsPointInsideTriangle(sample_point, trig.pos[0], trig.pos[1], trig.pos[2]))
-            {
-                ++covered_samples;
-                glm::vec3 bary = BarycentricCoordinate(glm::vec2(sample_x, sample_y), trig);
-                float depth = glm::dot(bary, glm::vec3(trig.pos[0].z, trig.pos[1].z, trig.pos[2].z));
-
-                // Update per-sample depth
-                float currentDepth = this->ZBufferSamples.Get(x, y, i);
-                if (depth < currentDepth)
-                {
-                    this->ZBufferSamples.Set(x, y, i, depth);
-                }
-            }
-        }
-
-        // Perform shading once per pixel
-        float coverage = static_cast<float>(covered_samples) / static_cast<float>(spp);
-        Color final_color = color * coverage;
-        image.Set(x, y, final_color);
-    }
-    return;
-}
-
 // AddModel function remains unchanged
 void Rasterizer::AddModel(MeshTransform transform, glm::mat4 rotation)
 {
@@ -215,91 +125,5 @@ void Rasterizer::SetScreenSpace()
     return;
 }
 
-// zBufferDefault remains unchanged
-float Rasterizer::zBufferDefault = -1.0f;
-
-// UpdateDepthAtPixel function updated to support MSAA
-void Rasterizer::UpdateDepthAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, ImageGrey& ZBuffer)
-{
-    // For MSAA, depth is handled per sample in ShadeAtPixel
-    // This function can remain unchanged or be adapted if needed
-    return;
-}
-
-// ShadeAtPixel function updated to implement MSAA
-void Rasterizer::ShadeAtPixel(uint32_t x, uint32_t y, Triangle original, Triangle transformed, Image& image)
-{
-    uint32_t spp = MSAA_SAMPLE_OFFSETS.size();
-    uint32_t covered_samples = 0;
-    float accumulated_coverage = 0.0f;
-
-    Color accumulated_color(0.0f);
-
-    for (uint32_t i = 0; i < spp; ++i)
-    {
-        float sample_x = static_cast<float>(x) + MSAA_SAMPLE_OFFSETS[i].x;
-        float sample_y = static_cast<float>(y) + MSAA_SAMPLE_OFFSETS[i].y;
-        glm::vec3 sample_point(sample_x, sample_y, 0.0f);
-
-        if (IsPointInsideTriangle(sample_point, transformed.pos[0], transformed.pos[1], transformed.pos[2]))
-        {
-            glm::vec3 bary = BarycentricCoordinate(glm::vec2(sample_x, sample_y), transformed);
-
-            // Compute depth
-            float depth = bary.x * transformed.pos[0].z + bary.y * transformed.pos[1].z + bary.z * transformed.pos[2].z;
-
-            // Get current depth from per-sample depth buffer
-            float currentDepth = this->ZBufferSamples.Get(x, y, i);
-
-            if (depth > currentDepth)
-            {
-                this->ZBufferSamples.Set(x, y, i, depth);
-                ++covered_samples;
-            }
-        }
-    }
-
-    if (covered_samples > 0)
-    {
-        // Perform shading once per pixel
-        glm::vec2 pos(x + 0.5f, y + 0.5f);
-        glm::vec3 bary = BarycentricCoordinate(pos, transformed);
-
-        // Interpolate position and normal
-        glm::vec3 interpolatedPos = bary.x * glm::vec3(original.pos[0]) + bary.y * glm::vec3(original.pos[1]) + bary.z * glm::vec3(original.pos[2]);
-        glm::vec3 normal = bary.x * original.normal[0] + bary.y * original.normal[1] + bary.z * original.normal[2];
-        normal = glm::normalize(normal);
-
-        // Lighting calculations
-        std::vector<Light> lights = this->loader.GetLights();
-        Color ambientColor = this->loader.GetAmbientColor();
-        float specularExponent = this->loader.GetSpecularExponent();
-        glm::vec3 cameraPos = this->loader.GetCamera().pos;
-
-        Color result = ambientColor;
-        for (const auto& light : lights)
-        {
-            glm::vec3 l = glm::normalize(light.pos - interpolatedPos);
-            glm::vec3 v = glm::normalize(cameraPos - interpolatedPos);
-            glm::vec3 h = glm::normalize(l + v);
-            float r2 = glm::length2(light.pos - interpolatedPos);
-
-            float NdotL = std::max(glm::dot(normal, l), 0.0f);
-            float NdotH = std::max(glm::dot(normal, h), 0.0f);
-
-            Color diffuse = light.color * (light.intensity / r2) * NdotL;
-            Color specular = light.color * (light.intensity / r2) * glm::pow(NdotH, specularExponent);
-
-            result = result + diffuse + specular;
-        }
-
-        // Apply coverage
-        float coverage = static_cast<float>(covered_samples) / static_cast<float>(spp);
-        Color final_color = result * coverage;
-
-        // Set the pixel color
-        image.Set(x, y, final_color);
-    }
-
-    return;
-}
+// Depth is stored reversed-Z, so the cleared value is the one of a point infinitely far away
+float Rasterizer::zBufferDefault = 0.0f;
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <string>
 
+#include "geometry.hpp"
 #include "image.hpp"
 #include "loader.hpp"
 #include "rasterizer.hpp"
@@ -80,16 +82,13 @@ void Renderer::Render(int argc, char** argv)
                 0        , 0         , 0, 0,             // discard z values
                 halfWidth, halfHeight, 0, 1
             };
-            rasterizer.model.push_back(glm::mat4x4(1.0f));      // Add an identity model matrix to avoid special judgement below
+            // no instance is added: shapes without instances are drawn once with an identity model matrix below
         }
         else
         {
-            // First load the matrices to the rasterizer
-            for (size_t index = 0; index != loader.GetTransforms().size(); ++index)
-            {
-                MeshTransform transform = loader.GetTransforms()[index];
-                rasterizer.AddModel(transform);
-            }
+            // First load the matrices of every instance to the rasterizer
+            for (const std::vector<MeshTransform>& instances : loader.GetTransforms())
+                rasterizer.AddInstances(instances);
 
             rasterizer.SetView();
             rasterizer.SetProjection();
@@ -114,90 +113,95 @@ void Renderer::Render(int argc, char** argv)
         }
         else 
         {
-            auto& shapes = loader.GetShapes();
-            auto& attribs = loader.GetAttribs();
+            auto& meshes = loader.GetMeshes();
+            auto& lods = loader.GetLODs();
 
             if (loader.GetType() == TestType::SHADING_DEPTH || loader.GetType() == TestType::SHADING)
                 rasterizer.InitZBuffer(rasterizer.ZBuffer);
+            if (loader.GetType() == TestType::SHADING)
+                rasterizer.InitSampleColors();
 
-            std::vector<Triangle> transformedTrigs;
-            std::vector<Triangle> originalTrigs;
-            
-            const size_t fv = 3;
-            for (size_t s = 0; s < shapes.size(); s++) 
+            // Collect the visible instances of every shape at their level of detail
+            std::vector<DrawCall> calls;
+            const glm::mat4 identity(1.f);
+            for (size_t s = 0; s < meshes.size(); s++) 
             {
-                if (loader.GetType() == TestType::SHADING)
+                // fall back to a single instance with identity so that the program will not crash without model matrices
+                const glm::mat4* instances = &identity;
+                size_t instanceCount = 1;
+                if (s + 1 < rasterizer.instanceStart.size())
                 {
-                    transformedTrigs.clear();
-                    originalTrigs.clear();
-                    transformedTrigs.reserve(shapes.size());
-                    originalTrigs.reserve(shapes.size());
+                    instances = rasterizer.model.data() + rasterizer.instanceStart[s];
+                    instanceCount = rasterizer.instanceStart[s + 1] - rasterizer.instanceStart[s];
                 }
 
-                // Loop over faces(polygon)
-                size_t index_offset = 0;
-                for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) 
+                for (size_t instance = 0; instance < instanceCount; ++instance)
                 {
-                    // Loop over vertices in the face.
-                    Triangle transformed, original;
-                    for (size_t v = 0; v < fv; v++) 
+                    const glm::mat4& modelMat = instances[instance];
+                    const ShapeLOD& lod = lods[s];
+
+                    // Skip instances whose bounding sphere lies outside the view frustum
+                    if (loader.GetType() != TestType::TRIANGLE)
                     {
-                        // access to vertex
-                        tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                        tinyobj::real_t vx = attribs.vertices[3 * size_t(idx.vertex_index) + 0];
-                        tinyobj::real_t vy = attribs.vertices[3 * size_t(idx.vertex_index) + 1];
-                        tinyobj::real_t vz = attribs.vertices[3 * size_t(idx.vertex_index) + 2];
-                        glm::vec4 vec(vx, vy, vz, 1);
-                        
-                        // init to identity so that the program will no crash even without model matrices being added
-                        glm::mat4 modelMat = glm::mat4(1.f);
-                        if (rasterizer.model.size() > s)
-                            modelMat = rasterizer.model[s];
-
-                        if (loader.GetType() == TestType::TRIANGLE)
-                            transformed.pos[v] = viewxprojection * vec;
-                        else
-                            transformed.pos[v] = viewxprojection * modelMat * vec;
-
-                        original.pos[v] = modelMat * vec;
-
-                        if (idx.normal_index >= 0) 
-                        {
-                            tinyobj::real_t nx = attribs.normals[3 * size_t(idx.normal_index) + 0];
-                            tinyobj::real_t ny = attribs.normals[3 * size_t(idx.normal_index) + 1];
-                            tinyobj::real_t nz = attribs.normals[3 * size_t(idx.normal_index) + 2];
-                            original.normal[v] = modelMat * glm::vec4(nx, ny, nz, 1);
-                        }
+                        glm::vec3 center = glm::vec3(modelMat * glm::vec4(lod.center, 1));
+                        float scale = std::max({ glm::length(glm::vec3(modelMat[0])), glm::length(glm::vec3(modelMat[1])), glm::length(glm::vec3(modelMat[2])) });
+                        if (!IsSphereVisible(center, lod.radius * scale, rasterizer.view, loader.GetCamera()))
+                            continue;
                     }
 
-                    transformed.Homogenize();
+                    // Pick the level of detail from the projected size of the instance; level 0 is the shape itself
+                    size_t level = SelectLOD(lod, modelMat, loader.GetCamera(), loader.GetWidth(), loader.GetLODConfig().threshold);
+                    calls.push_back({ static_cast<uint32_t>(s), &meshes[s].levels[level], modelMat });
+                }
+            }
+
+            // Geometry stage: transform and assemble every face up front, in parallel
+            TriangleStream stream;
+            float nearClip = loader.GetType() == TestType::TRIANGLE ? 0.f : loader.GetCamera().nearClip;
+            RunGeometryStage(calls, meshes.size(), viewxprojection, nearClip, stream);
+
+            // Rasterization stage: pick the kernels once, then consume the stream shape by shape, in the order the
+            //   faces were submitted. Shading starts once every shape is in the depth buffer, so only the samples
+            //   left visible at the end take a color
+            RasterTarget target = rasterizer.GetRasterTarget(&image, Color::White);
+            RasterKernel kernel = nullptr, shadeKernel = nullptr;
+            if (loader.GetType() == TestType::TRIANGLE || loader.GetType() == TestType::TRANSFORM)
+                kernel = SelectRasterKernel(RasterAttributes::FLAT, loader.GetAntiAliasConfig(), loader.GetSpp());
+            else if (loader.GetType() == TestType::SHADING_DEPTH || loader.GetType() == TestType::SHADING)
+                kernel = SelectRasterKernel(RasterAttributes::DEPTH, loader.GetAntiAliasConfig(), loader.GetSpp());
+            if (loader.GetType() == TestType::SHADING)
+                shadeKernel = SelectRasterKernel(RasterAttributes::SHADED, loader.GetAntiAliasConfig(), loader.GetSpp());
+
+            for (size_t s = 0; s < meshes.size(); s++) 
+            {
+                for (size_t t = stream.GetShapeBegin(s); t < stream.GetShapeEnd(s); ++t)
+                {
+                    Triangle transformed = stream.GetTransformed(t);
 
 #if defined PRINT_TRIG_DETAIL
                     PrintTaskTriangle(transformed);
 #endif
 
-                    if (loader.GetType() == TestType::TRIANGLE || loader.GetType() == TestType::TRANSFORM)
-                        rasterizer.DrawPrimitiveRaw(image, transformed, loader.GetAntiAliasConfig(), loader.GetSpp());
-                    else if (loader.GetType() == TestType::SHADING_DEPTH || loader.GetType() == TestType::SHADING)
-                        rasterizer.DrawPrimitiveDepth(transformed, original, rasterizer.ZBuffer);
-                    
-                    if (loader.GetType() == TestType::SHADING)
-                    {
-                        transformedTrigs.push_back(transformed);
-                        originalTrigs.push_back(original);
-                    }
-
-                    index_offset += fv;
+                    if (kernel)
+                        kernel(target, transformed, stream.GetOriginal(t));
                 }
+            }
 
-                if (loader.GetType() == TestType::SHADING)
-                    for (size_t i = 0; i < transformedTrigs.size(); ++i)
-                        rasterizer.DrawPrimitiveShaded(transformedTrigs[i], originalTrigs[i], image);
+            if (shadeKernel)
+            {
+                for (size_t s = 0; s < meshes.size(); s++)
+                    for (size_t t = stream.GetShapeBegin(s); t < stream.GetShapeEnd(s); ++t)
+                        shadeKernel(target, stream.GetTransformed(t), stream.GetOriginal(t));
+                rasterizer.ResolveShading(image);
             }
         }
 
         if (loader.GetType() == TestType::SHADING_DEPTH)
-            rasterizer.ZBuffer.Write();
+        {
+            ImageGrey depthImage(loader.GetWidth(), loader.GetHeight());
+            rasterizer.ResolveDepth(rasterizer.ZBuffer, depthImage);
+            depthImage.Write();
+        }
         else if (loader.GetType() != TestType::TRANSFORM_TEST)
             image.Write();
     }
@@ -2,9 +2,8 @@
 #include "Config.h"
 #include <cassert>
 #include <algorithm>
-
-// Very important! Set it to 1E-9 and you'll likely see self-occlusion artifacts.
-constexpr float MIN_TRAVEL_TIME = 1e-3;
+#include <limits>
+#include "Simd.h"
 
 BoundingBox BoundingBox::boxUnion(const BoundingBox& b1, const BoundingBox& b2) {
     return {
@@ -20,6 +19,16 @@ BoundingBox BoundingBox::constructFromMesh(const Mesh &mesh) {
     };
 }
 
+BoundingBox BoundingBox::empty() {
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    return {{inf, inf, inf}, {-inf, -inf, -inf}};
+}
+
+void BoundingBox::boxUnion(const Vec3 &point) {
+    this->minCorner = Vec3::minOfTwo(this->minCorner, point);
+    this->maxCorner = Vec3::maxOfTwo(this->maxCorner, point);
+}
+
 void BoundingBox::boxUnion(const BoundingBox &other) {
     this->minCorner = Vec3::minOfTwo(this->minCorner, other.minCorner);
     this->maxCorner = Vec3::maxOfTwo(this->maxCorner, other.maxCorner);
@@ -41,64 +50,29 @@ BoundingBox::Extent BoundingBox::maxExtent() const {
     return Extent::z;
 }
 
-float BoundingBox::intersect(const Ray &ray) const {
-    // assert (ray.isNormalized());
-
-    float tmin = (minCorner.x - ray.pos.x) / ray.dir.x;
-    float tmax = (maxCorner.x - ray.pos.x) / ray.dir.x;
-
-    if (tmin > tmax) std::swap(tmin, tmax);
-
-    float tymin = (minCorner.y - ray.pos.y) / ray.dir.y;
-    float tymax = (maxCorner.y - ray.pos.y) / ray.dir.y;
-
-    if (tymin > tymax) std::swap(tymin, tymax);
-
-    if ((tmin > tymax) || (tymin > tmax))
-        return std::numeric_limits<float>::max();
-
-    if (tymin > tmin)
-        tmin = tymin;
-
-    if (tymax < tmax)
-        tmax = tymax;
-
-    float tzmin = (minCorner.z - ray.pos.z) / ray.dir.z;
-    float tzmax = (maxCorner.z - ray.pos.z) / ray.dir.z;
-
-    if (tzmin > tzmax) std::swap(tzmin, tzmax);
-
-    if ((tmin > tzmax) || (tzmin > tmax)) {
-        return std::numeric_limits<float>::max();
-    }
-
-    if (tzmin > tmin)
-        tmin = tzmin;
-
-    if (tzmax < tmax)
-        tmax = tzmax;
-
-    if (tmax > 0.0f) {
-        return tmin;
-    }
-    return std::numeric_limits<float>::max();
+float BoundingBox::surfaceArea() const {
+    Vec3 d = diagonal();
+    return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
 }
 
-Intersection Object::sample() const {
-    float currentArea = 0;
-    size_t idx = 0;
-    float sampleArea = Random::randUniformFloat() * area;
-    while (true) {
-        currentArea += meshes[idx].area;
-        if (currentArea + std::numeric_limits<float>::epsilon() >= sampleArea) break;
-        idx++;
-    }
-    Intersection inter;
-    inter.happened = true;
-    inter.mesh = &meshes[idx];
-    inter.object = this;
-    inter.pos = meshes[idx].sample();
-    return inter;
+float BoundingBox::intersect(const Ray &ray) const {
+    // the ray enters through the min plane of an axis it travels along, and through the max plane otherwise
+    float nearX = ray.dirIsNeg[0] ? maxCorner.x : minCorner.x, farX = ray.dirIsNeg[0] ? minCorner.x : maxCorner.x;
+    float nearY = ray.dirIsNeg[1] ? maxCorner.y : minCorner.y, farY = ray.dirIsNeg[1] ? minCorner.y : maxCorner.y;
+    float nearZ = ray.dirIsNeg[2] ? maxCorner.z : minCorner.z, farZ = ray.dirIsNeg[2] ? minCorner.z : maxCorner.z;
+
+    // a ray in the plane of a face gives 0 * inf = NaN; these return the running bound then, ignoring the slab
+    auto max = [](float t, float bound) { return t > bound ? t : bound; };
+    auto min = [](float t, float bound) { return t < bound ? t : bound; };
+    float tNear = ray.tMin, tFar = ray.tMax;
+    tNear = max((nearX - ray.pos.x) * ray.invDir.x, tNear);
+    tNear = max((nearY - ray.pos.y) * ray.invDir.y, tNear);
+    tNear = max((nearZ - ray.pos.z) * ray.invDir.z, tNear);
+    tFar = min((farX - ray.pos.x) * ray.invDir.x, tFar);
+    tFar = min((farY - ray.pos.y) * ray.invDir.y, tFar);
+    tFar = min((farZ - ray.pos.z) * ray.invDir.z, tFar);
+
+    return tNear <= tFar ? tNear : std::numeric_limits<float>::max();
 }
 
 void Object::constructBoundingBox()
@@ -111,55 +85,187 @@ void Object::constructBoundingBox()
     }
 }
 
-BVHNode* BVH::build(const std::vector<Object *> &objects) {
+void BVH::build(const std::vector<Object *> &objects) {
     assert (!objects.empty());
-    BoundingBox box = objects[0]->box;
-    for (size_t i = 1; i < objects.size(); i++) {
-        box.boxUnion(objects[i]->box);
+
+    std::vector<BuildItem> items;
+    for (const Object* object : objects) {
+        for (const Mesh& mesh : object->meshes) {
+            BoundingBox box = BoundingBox::constructFromMesh(mesh);
+            items.push_back({box, box.centroid(), {&mesh, object}});
+        }
+    }
+    assert (!items.empty());
+
+    // leaves append their triangles as they are created
+    primitives.clear();
+    primitives.reserve(items.size());
+    packs.clear();
+    nodes.clear();
+    // a binary tree over n leaves has 2n - 1 nodes
+    nodes.reserve(2 * items.size() - 1);
+    buildRange(items, 0, items.size(), 0);
+
+    wideNodes.clear();
+    if constexpr (BVH_WIDTH > 2) {
+        collapse(0);
     }
+}
 
-    auto node = new BVHNode();
-    node->box = box;
-    auto numObjects = objects.size();
+void BVH::buildRange(std::vector<BuildItem>& items, size_t begin, size_t end, int depth) {
+    BoundingBox box = BoundingBox::empty();
+    for (size_t i = begin; i < end; i++) {
+        box.boxUnion(items[i].box);
+    }
 
-    if (numObjects == 1) {
-        node->object = objects[0];
+    size_t index = nodes.size();
+    nodes.emplace_back();
+    nodes[index].box = box;
+
+    // every level above a node may leave one entry on the traversal stack
+    int axis = 0;
+    size_t mid = depth + 1 < BVH_STACK_SIZE ? splitRange(items, begin, end, box, axis) : begin;
+    if (mid == begin) {
+        size_t packCount = (end - begin + TRIANGLE_PACK_WIDTH - 1) / TRIANGLE_PACK_WIDTH;
+        assert (packCount <= std::numeric_limits<uint16_t>::max());
+        nodes[index].offset = static_cast<uint32_t>(packs.size());
+        nodes[index].packCount = static_cast<uint16_t>(packCount);
+        for (size_t i = begin; i < end; i++) {
+            if ((i - begin) % TRIANGLE_PACK_WIDTH == 0) packs.emplace_back();
+            auto primitive = static_cast<uint32_t>(primitives.size());
+            primitives.push_back(items[i].primitive);
+            packs.back().setTriangle(static_cast<int>((i - begin) % TRIANGLE_PACK_WIDTH), *items[i].primitive.mesh, primitive);
+        }
     } else {
-        auto [firstHalf, secondHalf] = splitObjects(objects, box);
-        node->left = build(firstHalf);
-        node->right = build(secondHalf);
+        nodes[index].axis = static_cast<uint8_t>(axis);
+        buildRange(items, begin, mid, depth + 1);
+        nodes[index].offset = static_cast<uint32_t>(nodes.size());
+        buildRange(items, mid, end, depth + 1);
     }
-    
-    return node;
 }
 
-std::pair<std::vector<Object *>, std::vector<Object *>> BVH::splitObjects(std::vector<Object *> objects, const BoundingBox& box) {
-    assert (objects.size() > 1);
+uint32_t BVH::collapse(uint32_t index) {
+    auto wideIndex = static_cast<uint32_t>(wideNodes.size());
+    wideNodes.emplace_back();
 
-    BoundingBox::Extent maxExt = box.maxExtent();
-    if (maxExt == BoundingBox::Extent::x) {
-        std::sort(objects.begin(), objects.end(), 
-        [](const Object* lhs, const Object* rhs){
-            return lhs->box.centroid().x < rhs->box.centroid().x;
-        });
-    } else if (maxExt == BoundingBox::Extent::y) {
-        std::sort(objects.begin(), objects.end(), 
-        [](const Object* lhs, const Object* rhs){
-            return lhs->box.centroid().y < rhs->box.centroid().y;
-        });
+    // binary nodes standing for the children; only the root can be a leaf itself
+    uint32_t children[BVH_WIDTH];
+    int childCount = 0;
+    if (nodes[index].isLeaf()) {
+        children[childCount++] = index;
     } else {
-        std::sort(objects.begin(), objects.end(), 
-        [](const Object* lhs, const Object* rhs){
-            return lhs->box.centroid().z < rhs->box.centroid().z;
-        });
+        children[childCount++] = index + 1;
+        children[childCount++] = nodes[index].offset;
+    }
+    while (childCount < BVH_WIDTH) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (int i = 0; i < childCount; i++) {
+            const BVHNode& child = nodes[children[i]];
+            if (!child.isLeaf() && child.box.surfaceArea() > largestArea) {
+                largest = i;
+                largestArea = child.box.surfaceArea();
+            }
+        }
+        if (largest < 0) break;
+        uint32_t opened = children[largest];
+        children[largest] = opened + 1;
+        children[childCount++] = nodes[opened].offset;
     }
 
-    auto midIter = objects.begin() + objects.size() / 2;
+    for (int i = 0; i < childCount; i++) {
+        const BVHNode& child = nodes[children[i]];
+        if (child.isLeaf()) {
+            wideNodes[wideIndex].setChild(i, child.box, child.offset, child.packCount);
+        } else {
+            // the recursion appends to wideNodes, so no reference is held across it
+            uint32_t grandchild = collapse(children[i]);
+            wideNodes[wideIndex].setChild(i, child.box, grandchild, 0);
+        }
+    }
+    return wideIndex;
+}
 
-    return {
-        {objects.begin(), midIter},
-        {midIter, objects.end()}
+size_t BVH::splitRange(std::vector<BuildItem>& items, size_t begin, size_t end, const BoundingBox& box, int& axis) {
+    size_t count = end - begin;
+    if (count <= BVH_MIN_LEAF_SIZE) return begin;
+
+    BoundingBox centroidBox = BoundingBox::empty();
+    for (size_t i = begin; i < end; i++) {
+        centroidBox.boxUnion(items[i].centroid);
+    }
+
+    // all centroids coincide: no plane separates them, so split in the middle unless a leaf is allowed
+    axis = static_cast<int>(centroidBox.maxExtent());
+    float extent = centroidBox.diagonal()[axis];
+    if (extent <= 0.0f) {
+        return count <= BVH_MAX_LEAF_SIZE ? begin : begin + count / 2;
+    }
+
+    struct Bin {
+        BoundingBox box = BoundingBox::empty();
+        size_t count = 0;
     };
+    auto binOf = [&](const BuildItem& item, int a) {
+        float lo = centroidBox.minCorner[a], span = centroidBox.diagonal()[a];
+        int b = static_cast<int>(BVH_SAH_BINS * ((item.centroid[a] - lo) / span));
+        return std::clamp(b, 0, BVH_SAH_BINS - 1);
+    };
+
+    // evaluate the planes between bins along every axis with some extent
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestPlane = -1;
+    for (int a = 0; a < 3; a++) {
+        if (centroidBox.diagonal()[a] <= 0.0f) continue;
+
+        Bin bins[BVH_SAH_BINS];
+        for (size_t i = begin; i < end; i++) {
+            Bin& bin = bins[binOf(items[i], a)];
+            bin.box.boxUnion(items[i].box);
+            bin.count++;
+        }
+
+        // sweep from the right to get the area and count on the right of every plane
+        float rightArea[BVH_SAH_BINS];
+        size_t rightCount[BVH_SAH_BINS];
+        BoundingBox rightBox = BoundingBox::empty();
+        size_t rightSum = 0;
+        for (int p = BVH_SAH_BINS - 1; p > 0; p--) {
+            rightBox.boxUnion(bins[p].box);
+            rightSum += bins[p].count;
+            rightArea[p] = rightSum ? rightBox.surfaceArea() : 0.0f;
+            rightCount[p] = rightSum;
+        }
+
+        BoundingBox leftBox = BoundingBox::empty();
+        size_t leftSum = 0;
+        for (int p = 1; p < BVH_SAH_BINS; p++) {
+            leftBox.boxUnion(bins[p - 1].box);
+            leftSum += bins[p - 1].count;
+            if (leftSum == 0 || rightCount[p] == 0) continue;
+            float cost = leftBox.surfaceArea() * leftSum + rightArea[p] * rightCount[p];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = a;
+                bestPlane = p;
+            }
+        }
+    }
+
+    // expected cost of the split relative to testing every triangle of a leaf
+    float area = box.surfaceArea();
+    float splitCost = BVH_TRAVERSAL_COST + BVH_INTERSECT_COST * (area > 0.0f ? bestCost / area : static_cast<float>(count));
+    float leafCost = BVH_INTERSECT_COST * count;
+    if (count <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= leafCost)) return begin;
+
+    if (bestAxis < 0) return begin + count / 2;
+
+    axis = bestAxis;
+    auto midIter = std::partition(items.begin() + begin, items.begin() + end,
+        [&](const BuildItem& item) {
+            return binOf(item, bestAxis) < bestPlane;
+        });
+    return midIter - items.begin();
 }
 
 Mesh::Mesh(const Vec3 &a, const Vec3 &b, const Vec3 &c) 
@@ -170,78 +276,319 @@ Mesh::Mesh(const Vec3 &a, const Vec3 &b, const Vec3 &c)
     normal.normalize();
 }
 
-float Mesh::intersect(const Ray &ray) {
-    if constexpr(DEBUG) {
-        assert (ray.isNormalized());
+Vec3 Mesh::sample(Sampler &sampler) const {
+    auto [u, v] = sampler.get2D();
+    float m = std::sqrt(u), n = v;
+    return a * (1.0f - m) + b * (m * (1.0f - n)) + c * (m * n);
+}
+
+Intersection BVH::intersect(const Ray &ray) const {
+    Ray active(ray.pos, ray.dir, std::max(ray.tMin, MIN_TRAVEL_TIME), ray.tMax);
+    if constexpr (BVH_WIDTH > 2) {
+        return intersectWide(active);
+    } else {
+        return intersectBinary(active);
     }
-    float proj = ray.dir.dot(normal);
+}
 
-    // we ignore intersection with the backface
-    if (proj > 0) return std::numeric_limits<float>::max();
-    
-    // find the plane defined by this triangle mesh
-    // plane expression: n dot x + delta = 0
-    float delta = -normal.dot(a);
+bool BVH::occluded(const Ray &ray) const {
+    Ray active(ray.pos, ray.dir, std::max(ray.tMin, MIN_TRAVEL_TIME), ray.tMax);
+    if constexpr (BVH_WIDTH > 2) {
+        return occludedWide(active);
+    } else {
+        return occludedBinary(active);
+    }
+}
 
-    float time = - (delta + normal.dot(ray.pos)) / proj;
-    if (time < 0) return std::numeric_limits<float>::max();
-    
-    Vec3 inter = ray.travel(time);
-    if (isPointInsideMesh(inter)) return time;
-    return std::numeric_limits<float>::max();
+TrianglePack::TrianglePack() {
+    for (int i = 0; i < TRIANGLE_PACK_WIDTH; i++) {
+        v0x[i] = v0y[i] = v0z[i] = 0.0f;
+        e1x[i] = e1y[i] = e1z[i] = 0.0f;
+        e2x[i] = e2y[i] = e2z[i] = 0.0f;
+        primitive[i] = 0;
+    }
 }
 
-Vec3 Mesh::sample() const {
-    float m = std::sqrt(Random::randUniformFloat()), n = Random::randUniformFloat();
-    return a * (1.0f - m) + b * (m * (1.0f - n)) + c * (m * n);
+void TrianglePack::setTriangle(int lane, const Mesh &mesh, uint32_t primitive) {
+    Vec3 e1 = mesh.b - mesh.a, e2 = mesh.c - mesh.a;
+    v0x[lane] = mesh.a.x;
+    v0y[lane] = mesh.a.y;
+    v0z[lane] = mesh.a.z;
+    e1x[lane] = e1.x;
+    e1y[lane] = e1.y;
+    e1z[lane] = e1.z;
+    e2x[lane] = e2.x;
+    e2y[lane] = e2.y;
+    e2z[lane] = e2.z;
+    this->primitive[lane] = primitive;
 }
 
-bool Mesh::isPointInsideMesh(const Vec3& point) const {
-    Vec3 i = point - a, j = point - b, k = point - c;
-    auto isValid = [this](const Vec3& m, const Vec3& n) -> bool {
-        return m.cross(n).dot(normal) > 0;
-        };
-    return isValid(i, j) && isValid(j, k) && isValid(k, i);
+WideBVHNode::WideBVHNode() {
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    for (int i = 0; i < BVH_WIDTH; i++) {
+        minX[i] = minY[i] = minZ[i] = inf;
+        maxX[i] = maxY[i] = maxZ[i] = -inf;
+        child[i] = 0;
+        packCount[i] = 0;
+    }
+}
+
+void WideBVHNode::setChild(int slot, const BoundingBox &box, uint32_t child, uint16_t packCount) {
+    minX[slot] = box.minCorner.x;
+    minY[slot] = box.minCorner.y;
+    minZ[slot] = box.minCorner.z;
+    maxX[slot] = box.maxCorner.x;
+    maxY[slot] = box.maxCorner.y;
+    maxZ[slot] = box.maxCorner.z;
+    this->child[slot] = child;
+    this->packCount[slot] = packCount;
+}
+
+namespace {
+
+/**
+ * @brief test the ray against all the child boxes of a node within [ray.tMin, ray.tMax]
+ * @param entryTime: receives the time the ray enters every child box
+ * @return a mask with bit i set if child i is hit
+ * a 0 * inf slab distance, for a ray in the plane of a face, is a NaN; `max` and `min` return their second
+ * operand in that case, which is the running bound, so the NaN is ignored
+*/
+int intersectChildren(const WideBVHNode& node, const Ray& ray, float entryTime[BVH_WIDTH]) {
+    using Float = SimdFloat<BVH_WIDTH>;
+    auto slab = [](const float* planes, float pos, float invDir) {
+        return (Float::load(planes) - Float::broadcast(pos)) * Float::broadcast(invDir);
+    };
+
+    Float tNear = Float::broadcast(ray.tMin), tFar = Float::broadcast(ray.tMax);
+    tNear = max(slab(ray.dirIsNeg[0] ? node.maxX : node.minX, ray.pos.x, ray.invDir.x), tNear);
+    tNear = max(slab(ray.dirIsNeg[1] ? node.maxY : node.minY, ray.pos.y, ray.invDir.y), tNear);
+    tNear = max(slab(ray.dirIsNeg[2] ? node.maxZ : node.minZ, ray.pos.z, ray.invDir.z), tNear);
+    tFar = min(slab(ray.dirIsNeg[0] ? node.minX : node.maxX, ray.pos.x, ray.invDir.x), tFar);
+    tFar = min(slab(ray.dirIsNeg[1] ? node.minY : node.maxY, ray.pos.y, ray.invDir.y), tFar);
+    tFar = min(slab(ray.dirIsNeg[2] ? node.minZ : node.maxZ, ray.pos.z, ray.invDir.z), tFar);
+    tNear.store(entryTime);
+    return tNear <= tFar;
+}
+
+/**
+ * @brief Möller–Trumbore against all the triangles of a pack
+ * @param hitTime, u, v: receive the time and the barycentric coordinates of the hit in every lane
+ * @return a mask with bit i set if triangle i is hit within (ray.tMin, ray.tMax)
+ * a ray parallel to a triangle divides by a zero determinant; the NaNs and infinities it makes fail the range tests
+*/
+int intersectPack(const TrianglePack& pack, const Ray& ray, float hitTime[TRIANGLE_PACK_WIDTH], float u[TRIANGLE_PACK_WIDTH], float v[TRIANGLE_PACK_WIDTH]) {
+    using Float = SimdFloat<TRIANGLE_PACK_WIDTH>;
+    const Float dx = Float::broadcast(ray.dir.x), dy = Float::broadcast(ray.dir.y), dz = Float::broadcast(ray.dir.z);
+    const Float e1x = Float::load(pack.e1x), e1y = Float::load(pack.e1y), e1z = Float::load(pack.e1z);
+    const Float e2x = Float::load(pack.e2x), e2y = Float::load(pack.e2y), e2z = Float::load(pack.e2z);
+
+    // p = dir x e2
+    Float px = dy * e2z - dz * e2y, py = dz * e2x - dx * e2z, pz = dx * e2y - dy * e2x;
+    // the determinant is -dir . (e1 x e2): positive when the ray hits the front face
+    Float det = e1x * px + e1y * py + e1z * pz;
+    Float invDet = Float::broadcast(1.0f) / det;
+
+    Float tx = Float::broadcast(ray.pos.x) - Float::load(pack.v0x);
+    Float ty = Float::broadcast(ray.pos.y) - Float::load(pack.v0y);
+    Float tz = Float::broadcast(ray.pos.z) - Float::load(pack.v0z);
+    Float uu = (tx * px + ty * py + tz * pz) * invDet;
+
+    // q = (pos - v0) x e1
+    Float qx = ty * e1z - tz * e1y, qy = tz * e1x - tx * e1z, qz = tx * e1y - ty * e1x;
+    Float vv = (dx * qx + dy * qy + dz * qz) * invDet;
+    Float t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+    const Float zero = Float::broadcast(0.0f);
+    int mask = BACKFACE_CULLING ? det > zero : det != zero;
+    mask &= (uu >= zero) & (vv >= zero) & (uu + vv <= Float::broadcast(1.0f));
+    mask &= (t > Float::broadcast(ray.tMin)) & (t < Float::broadcast(ray.tMax));
+
+    t.store(hitTime);
+    uu.store(u);
+    vv.store(v);
+    return mask;
+}
+
+/**
+ * @brief the closest hit so far, updated in place by every leaf; its time is the tMax of the ray
+*/
+struct HitRecord {
+    uint32_t primitive = 0;
+    float u = 0.0f, v = 0.0f;
+    bool happened = false;
+};
+
+void intersectLeaf(const std::vector<TrianglePack>& packs, uint32_t first, uint16_t count, Ray& ray, HitRecord& hit) {
+    for (uint32_t p = first; p < first + count; p++) {
+        alignas(32) float hitTime[TRIANGLE_PACK_WIDTH], u[TRIANGLE_PACK_WIDTH], v[TRIANGLE_PACK_WIDTH];
+        // only hits closer than the current one pass, so the closest of them replaces it
+        int mask = intersectPack(packs[p], ray, hitTime, u, v);
+        for (int i = 0; i < TRIANGLE_PACK_WIDTH; i++) {
+            if ((mask & (1 << i)) && hitTime[i] < ray.tMax) {
+                ray.tMax = hitTime[i];
+                hit.primitive = packs[p].primitive[i];
+                hit.u = u[i];
+                hit.v = v[i];
+                hit.happened = true;
+            }
+        }
+    }
 }
 
-Intersection BVHNode::intersect(const Ray &ray) {
-    if (box.intersect(ray) >= std::numeric_limits<float>::max()) {
-        return {};
+bool occludedLeaf(const std::vector<TrianglePack>& packs, uint32_t first, uint16_t count, const Ray& ray) {
+    for (uint32_t p = first; p < first + count; p++) {
+        alignas(32) float hitTime[TRIANGLE_PACK_WIDTH], u[TRIANGLE_PACK_WIDTH], v[TRIANGLE_PACK_WIDTH];
+        if (intersectPack(packs[p], ray, hitTime, u, v)) return true;
     }
-    if (isLeaf()) {
-        float shortestHitTime = std::numeric_limits<float>::max();
-        Mesh* targetMesh;
-        for (auto& mesh : object->meshes) {
-            float hitTime = mesh.intersect(ray);
-            if (hitTime > MIN_TRAVEL_TIME && hitTime < shortestHitTime) {
-                shortestHitTime = hitTime;
-                targetMesh = &mesh;
+    return false;
+}
+
+/**
+ * @brief the Intersection for the closest hit of a traversal, or an empty one if nothing was hit
+*/
+Intersection makeIntersection(const std::vector<Primitive>& primitives, const Ray& ray, const HitRecord& hit) {
+    if (!hit.happened) return {};
+
+    const Primitive& target = primitives[hit.primitive];
+    Intersection result;
+    result.happened = true;
+    result.time = ray.tMax;
+    result.mesh = target.mesh;
+    result.pos = ray.travel(ray.tMax);
+    result.object = target.object;
+    result.u = hit.u;
+    result.v = hit.v;
+    return result;
+}
+
+// a child waiting on the traversal stack; leaves are pushed as their pack range
+struct WideStackEntry {
+    uint32_t child;
+    uint16_t packCount;
+    float entryTime;
+};
+
+// a node pushes up to BVH_WIDTH children and pops one, at every level of the tree
+constexpr int WIDE_STACK_SIZE = BVH_STACK_SIZE * (BVH_WIDTH - 1) + 1;
+
+} // namespace
+
+Intersection BVH::intersectBinary(Ray ray) const {
+    HitRecord hit;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    uint32_t current = 0;
+    while (true) {
+        const BVHNode& node = nodes[current];
+        // tMax is the closest hit so far: a node entered beyond it cannot hold a closer one
+        if (node.box.intersect(ray) < std::numeric_limits<float>::max()) {
+            if (!node.isLeaf()) {
+                // visit the nearer child next, come back for the other one later
+                if (ray.dirIsNeg[node.axis]) {
+                    stack[stackSize++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stackSize++] = node.offset;
+                    current++;
+                }
+                continue;
             }
+            intersectLeaf(packs, node.offset, node.packCount, ray, hit);
         }
+        if (stackSize == 0) break;
+        current = stack[--stackSize];
+    }
+    return makeIntersection(primitives, ray, hit);
+}
 
-        if (shortestHitTime == std::numeric_limits<float>::max()) return {};
+bool BVH::occludedBinary(const Ray &ray) const {
+    uint32_t stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    uint32_t current = 0;
+    while (true) {
+        const BVHNode& node = nodes[current];
+        if (node.box.intersect(ray) < std::numeric_limits<float>::max()) {
+            if (!node.isLeaf()) {
+                if (ray.dirIsNeg[node.axis]) {
+                    stack[stackSize++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stackSize++] = node.offset;
+                    current++;
+                }
+                continue;
+            }
+            // any blocker will do, so there is no need to look for the closest one
+            if (occludedLeaf(packs, node.offset, node.packCount, ray)) return true;
+        }
+        if (stackSize == 0) break;
+        current = stack[--stackSize];
+    }
+    return false;
+}
+
+Intersection BVH::intersectWide(Ray ray) const {
+    HitRecord hit;
+
+    WideStackEntry stack[WIDE_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, 0.0f};
+    while (stackSize > 0) {
+        WideStackEntry entry = stack[--stackSize];
+        // the closest hit may have moved in front of the child since it was pushed
+        if (entry.entryTime > ray.tMax) continue;
 
-        Intersection result;
-        result.happened = true;
-        result.time = shortestHitTime;
-        result.mesh = targetMesh;
-        result.pos = ray.travel(shortestHitTime);
-        result.object = object;
-        return result;
+        if (entry.packCount > 0) {
+            intersectLeaf(packs, entry.child, entry.packCount, ray, hit);
+            continue;
+        }
+
+        const WideBVHNode& node = wideNodes[entry.child];
+        alignas(32) float entryTime[BVH_WIDTH];
+        int mask = intersectChildren(node, ray, entryTime);
+
+        // push the hit children far to near, so the nearest one is popped first
+        int first = stackSize;
+        for (int i = 0; i < BVH_WIDTH; i++) {
+            if (!(mask & (1 << i))) continue;
+            WideStackEntry child = {node.child[i], node.packCount[i], entryTime[i]};
+            int j = stackSize++;
+            for (; j > first && stack[j - 1].entryTime < child.entryTime; j--) {
+                stack[j] = stack[j - 1];
+            }
+            stack[j] = child;
+        }
     }
-    Intersection leftIntersect = left->intersect(ray);
-    Intersection rightIntersect = right->intersect(ray);
-    if (leftIntersect.happened) {
-        if (rightIntersect.happened) {
-            return leftIntersect.time < rightIntersect.time ? leftIntersect : rightIntersect;
+    return makeIntersection(primitives, ray, hit);
+}
+
+bool BVH::occludedWide(const Ray &ray) const {
+    WideStackEntry stack[WIDE_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, 0.0f};
+    while (stackSize > 0) {
+        WideStackEntry entry = stack[--stackSize];
+        if (entry.packCount > 0) {
+            if (occludedLeaf(packs, entry.child, entry.packCount, ray)) return true;
+            continue;
+        }
+
+        // any blocker will do, so the children are not sorted
+        const WideBVHNode& node = wideNodes[entry.child];
+        alignas(32) float entryTime[BVH_WIDTH];
+        int mask = intersectChildren(node, ray, entryTime);
+        for (int i = 0; i < BVH_WIDTH; i++) {
+            if (mask & (1 << i)) {
+                stack[stackSize++] = {node.child[i], node.packCount[i], entryTime[i]};
+            }
         }
-        return leftIntersect;
     }
-    return rightIntersect;
+    return false;
 }
 
 bool BVHNode::isLeaf() const {
-    return !left && !right;
+    return packCount > 0;
 }
 
 Vec3 Intersection::getNormal() const {
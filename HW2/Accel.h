@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Config.h"
 #include "Math.h"
 #include "Ray.h"
+#include <cstdint>
 #include <vector>
 
 class Mesh {
@@ -12,16 +14,10 @@ public:
     Vec3 normal;
     float area;
     Mesh(const Vec3& a, const Vec3& b, const Vec3& c);
-    /**
-     * returns the time that the ray travels before hitting this mesh
-     * returns FLOAT_MAX if they don't intersect
-    */
-    float intersect(const Ray& ray);
     /**
      * @brief sample a random point on the mesh surface
     */
-    Vec3 sample() const;
-    bool isPointInsideMesh(const Vec3& point) const;
+    Vec3 sample(Sampler& sampler) const;
 };
 
 class BoundingBox {
@@ -31,7 +27,12 @@ public:
 
     static BoundingBox boxUnion(const BoundingBox& b1, const BoundingBox& b2);
     static BoundingBox constructFromMesh(const Mesh&);
+    /**
+     * @brief an inverted box that any union replaces
+    */
+    static BoundingBox empty();
     void boxUnion(const BoundingBox& other);
+    void boxUnion(const Vec3& point);
 
     enum class Extent {
         x = 0,
@@ -41,11 +42,11 @@ public:
     Vec3 centroid() const;
     Vec3 diagonal() const;
     Extent maxExtent() const;
+    float surfaceArea() const;
 
     /**
-     * return the shortest time that the ray travels before hitting the bounding box
-     * return FLOAT_MAX if they don't intersect
-     * a negative return value means the ray starts from inside the box
+     * return the time the ray enters the bounding box, clamped to [ray.tMin, ray.tMax]
+     * return FLOAT_MAX if they don't intersect within that interval
     */
     float intersect(const Ray& ray) const;
 };
@@ -65,10 +66,7 @@ public:
     Vec3 kd; /* albedo */
     Vec3 ke; /* emission */
     bool hasEmission = false;
-    /**
-     * @brief sample a surface point
-    */
-    Intersection sample() const;
+    // points on the lights are sampled by the LightSampler, over the emissive triangles of all objects
     void constructBoundingBox();
 };
 
@@ -78,6 +76,8 @@ struct Intersection {
     const Object* object = nullptr;
     Vec3 pos;
     const Mesh* mesh = nullptr;
+    // barycentric coordinates of pos: the weights of mesh->b and mesh->c
+    float u = 0.0f, v = 0.0f;
 
     /* helper functions*/
     Vec3 getNormal() const;
@@ -87,22 +87,122 @@ struct Intersection {
     Vec3 calcBRDF(const Vec3& inDir, const Vec3& outDir) const;
 };
 
-class BVHNode {
-public:
-    BVHNode *left = nullptr, *right = nullptr;
+/**
+ * @brief a single triangle in the BVH, with the object it belongs to for shading
+*/
+struct Primitive {
+    const Mesh* mesh = nullptr;
+    const Object* object = nullptr;
+};
+
+/**
+ * @brief TRIANGLE_PACK_WIDTH triangles in SoA, set up for Möller–Trumbore and tested together
+ * unused lanes hold degenerate triangles, which no ray hits
+*/
+struct alignas(32) TrianglePack {
+    // first vertex and the two edges leaving it
+    float v0x[TRIANGLE_PACK_WIDTH], v0y[TRIANGLE_PACK_WIDTH], v0z[TRIANGLE_PACK_WIDTH];
+    float e1x[TRIANGLE_PACK_WIDTH], e1y[TRIANGLE_PACK_WIDTH], e1z[TRIANGLE_PACK_WIDTH];
+    float e2x[TRIANGLE_PACK_WIDTH], e2y[TRIANGLE_PACK_WIDTH], e2z[TRIANGLE_PACK_WIDTH];
+    // index of every triangle in BVH::primitives
+    uint32_t primitive[TRIANGLE_PACK_WIDTH];
+
+    TrianglePack();
+    void setTriangle(int lane, const Mesh& mesh, uint32_t primitive);
+};
+
+/**
+ * @brief a 32-byte node of the linear BVH
+ * nodes are stored in depth-first order, so the first child of an interior node directly follows it
+*/
+struct alignas(32) BVHNode {
     BoundingBox box;
-    Object* object = nullptr;
+    // leaves: the first triangle pack of their range in BVH::packs; interior nodes: the index of the second child
+    uint32_t offset = 0;
+    // 0 for interior nodes
+    uint16_t packCount = 0;
+    // interior nodes: the axis the children were split along, the first child being on its lower side
+    uint8_t axis = 0;
 
-    Intersection intersect(const Ray& ray);
     bool isLeaf() const;
 };
+static_assert(sizeof(BVHNode) == 32, "BVH nodes should fill half a cache line");
+
+/**
+ * @brief a node of the wide BVH, with the boxes of its BVH_WIDTH children in SoA so they are tested together
+ * unused slots have empty boxes, which no ray hits
+*/
+struct alignas(64) WideBVHNode {
+    float minX[BVH_WIDTH], minY[BVH_WIDTH], minZ[BVH_WIDTH];
+    float maxX[BVH_WIDTH], maxY[BVH_WIDTH], maxZ[BVH_WIDTH];
+    // leaves: the first triangle pack of their range in BVH::packs; interior nodes: their index in BVH::wideNodes
+    uint32_t child[BVH_WIDTH];
+    // triangle packs in the leaf children, 0 for interior children
+    uint16_t packCount[BVH_WIDTH];
+
+    WideBVHNode();
+    void setChild(int slot, const BoundingBox& box, uint32_t child, uint16_t packCount);
+};
 
 class BVH {
 public:
-    BVHNode *root = nullptr;
-    static BVHNode* build(const std::vector<Object*>& objects);
+    // the binary tree built with the SAH
+    std::vector<BVHNode> nodes;
+    // the binary tree collapsed to BVH_WIDTH children per node; unused when BVH_WIDTH is 2
+    std::vector<WideBVHNode> wideNodes;
+    // the triangles of every leaf, packed together
+    std::vector<TrianglePack> packs;
+    std::vector<Primitive> primitives;
+
+    /**
+     * @brief build a BVH over all the triangles of the objects, splitting with a binned SAH
+     * @note the objects must outlive the BVH
+    */
+    void build(const std::vector<Object*>& objects);
+    /**
+     * @brief find the closest hit along the ray, within its [tMin, tMax] but no closer than MIN_TRAVEL_TIME
+     * walks the nodes with a fixed-size stack, nearer child first, skipping nodes the ray enters beyond the closest
+     * hit found so far
+    */
+    Intersection intersect(const Ray& ray) const;
+    /**
+     * @brief whether anything is hit along the ray, within its (tMin, tMax) but no closer than MIN_TRAVEL_TIME
+     * returns on the first hit found, without looking for the closest one
+    */
+    bool occluded(const Ray& ray) const;
+
+private:
+    struct BuildItem {
+        BoundingBox box;
+        Vec3 centroid;
+        Primitive primitive;
+    };
+
+    /**
+     * @brief append the subtree over items [begin, end) to the nodes; leaves pack the triangles of their range
+     * @param depth: depth of the subtree root, bounded so traversal fits in its stack
+    */
+    void buildRange(std::vector<BuildItem>& items, size_t begin, size_t end, int depth);
+    /**
+     * @brief append the wide node standing for the subtree of binary node `index`
+     * the children of the node are pulled up, largest surface area first, until it has BVH_WIDTH of them
+     * @return the index of the wide node
+    */
+    uint32_t collapse(uint32_t index);
+    /**
+     * @brief closest hit and occlusion queries on the binary tree
+    */
+    Intersection intersectBinary(Ray ray) const;
+    bool occludedBinary(const Ray& ray) const;
+    /**
+     * @brief closest hit and occlusion queries on the wide tree
+    */
+    Intersection intersectWide(Ray ray) const;
+    bool occludedWide(const Ray& ray) const;
     /**
-     * @param box the bounding box of all the objects
+     * @brief find the SAH split of items [begin, end)
+     * @param axis: receives the axis of the split
+     * @return the index of the first item of the right child, or `begin` to make a leaf
     */
-    static std::pair<std::vector<Object*>, std::vector<Object*>> splitObjects(std::vector<Object*> objects, const BoundingBox& box);
+    size_t splitRange(std::vector<BuildItem>& items, size_t begin, size_t end, const BoundingBox& box, int& axis);
 };
\ No newline at end of file
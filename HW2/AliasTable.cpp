@@ -0,0 +1,56 @@
+#include "AliasTable.h"
+
+#include <algorithm>
+#include <cassert>
+
+AliasTable::AliasTable(const std::vector<float>& weights) : bins(weights.size()) {
+    assert (!weights.empty());
+    double sum = 0.0;
+    for (float weight : weights) {
+        assert (weight >= 0.0f);
+        sum += weight;
+    }
+    assert (sum > 0.0);
+
+    // the weights scaled so that they average 1; bins under 1 are topped up by an alias from those over 1
+    size_t n = weights.size();
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; i++) {
+        bins[i].pmf = static_cast<float>(weights[i] / sum);
+        scaled[i] = weights[i] / sum * n;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t under = small.back(), over = large.back();
+        small.pop_back();
+        large.pop_back();
+        bins[under].probability = static_cast<float>(scaled[under]);
+        bins[under].alias = over;
+        scaled[over] -= 1.0 - scaled[under];
+        (scaled[over] < 1.0 ? small : large).push_back(over);
+    }
+    // what is left is 1 up to rounding errors, and keeps its own index
+    for (uint32_t i : small) bins[i].probability = 1.0f;
+    for (uint32_t i : large) bins[i].probability = 1.0f;
+}
+
+uint32_t AliasTable::sample(float u) const {
+    assert (!bins.empty());
+    // the integer part of u * n picks the bin, the fraction decides between it and its alias
+    float scaled = u * bins.size();
+    uint32_t index = std::min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(bins.size() - 1));
+    return scaled - index < bins[index].probability ? index : bins[index].alias;
+}
+
+float AliasTable::pmf(uint32_t index) const {
+    return bins[index].pmf;
+}
+
+size_t AliasTable::size() const {
+    return bins.size();
+}
+
+bool AliasTable::empty() const {
+    return bins.empty();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief picks an index with probability proportional to its weight, in constant time (Vose's alias method)
+ * every bin keeps the chance of picking its own index, and the index it defers to otherwise
+*/
+class AliasTable {
+public:
+    AliasTable() = default;
+    /**
+     * @param weights: not negative, with a positive sum
+    */
+    explicit AliasTable(const std::vector<float>& weights);
+
+    /**
+     * @brief pick an index with a uniform number in [0, 1)
+    */
+    uint32_t sample(float u) const;
+    /**
+     * @brief probability of picking the index
+    */
+    float pmf(uint32_t index) const;
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    struct Bin {
+        float probability = 1.0f;  // of keeping the index of the bin rather than its alias
+        uint32_t alias = 0;
+        float pmf = 0.0f;
+    };
+
+    std::vector<Bin> bins;
+};
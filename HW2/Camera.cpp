@@ -0,0 +1,70 @@
+#include "Camera.h"
+
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief map the unit square onto the unit disk, keeping the areas and the neighbourhoods (Shirley and Chiu 1997)
+*/
+void concentricDisk(float u, float v, float& x, float& y) {
+    u = 2 * u - 1;
+    v = 2 * v - 1;
+    if (u == 0.0f && v == 0.0f) {
+        x = y = 0.0f;
+        return;
+    }
+    float radius, theta;
+    if (std::abs(u) > std::abs(v)) {
+        radius = u;
+        theta = PI / 4 * (v / u);
+    } else {
+        radius = v;
+        theta = PI / 2 - PI / 4 * (u / v);
+    }
+    x = radius * std::cos(theta);
+    y = radius * std::sin(theta);
+}
+
+} // namespace
+
+Camera::Camera(const Vec3 &position, const Vec3 &target, const Vec3 &up, float fov, int width, int height,
+               float aperture, float focusDistance)
+    : position(position), width(width), height(height), aperture(aperture), focusDistance(focusDistance) {
+    forward = target - position;
+    forward.normalize();
+    right = forward.cross(up);
+    right.normalize();
+    this->up = right.cross(forward);
+
+    halfHeight = std::tan(fov * PI / 360);
+    halfWidth = halfHeight * width / height;
+}
+
+Ray Camera::generateRay(float filmX, float filmY, float lensU, float lensV) const {
+    // the point of the film at distance 1 along the view direction
+    Vec3 dir = forward + right * ((2 * filmX / width - 1) * halfWidth) + up * ((1 - 2 * filmY / height) * halfHeight);
+    if (aperture <= 0.0f) {
+        dir.normalize();
+        return {position, dir};
+    }
+
+    // every ray through the lens from that point of the film meets the pinhole ray on the plane in focus
+    float lensX, lensY;
+    concentricDisk(lensU, lensV, lensX, lensY);
+    Vec3 origin = position + right * (lensX * aperture) + up * (lensY * aperture);
+    Vec3 focus = position + dir * focusDistance;
+    dir = focus - origin;
+    dir.normalize();
+    return {origin, dir};
+}
+
+CameraSample Camera::sample(int x, int y, Sampler &sampler) const {
+    CameraSample result;
+    auto [pixelU, pixelV] = sampler.get2D();
+    auto [lensU, lensV] = sampler.get2D();
+    result.filmX = x + pixelU;
+    result.filmY = y + pixelV;
+    result.ray = generateRay(result.filmX, result.filmY, lensU, lensV);
+    return result;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Ray.h"
+#include "Sampler.h"
+
+/**
+ * @brief a camera ray, and the point of the film it was taken for, in pixels
+*/
+struct CameraSample {
+    Ray ray;
+    float filmX = 0.0f, filmY = 0.0f;
+};
+
+/**
+ * @brief a perspective camera: a pinhole, or a thin lens when it has an aperture
+ * the film spans the vertical field of view, x to the right and y down, one unit per pixel
+*/
+class Camera {
+public:
+    /**
+     * @param fov: vertical field of view, in degrees
+     * @param aperture: radius of the lens, 0 for a pinhole
+     * @param focusDistance: distance along the view direction of the plane that is in focus through the lens
+    */
+    Camera(const Vec3& position, const Vec3& target, const Vec3& up, float fov, int width, int height,
+           float aperture, float focusDistance);
+
+    /**
+     * @brief the ray through the point (filmX, filmY) of the film, leaving the lens at (lensU, lensV) of the unit square
+    */
+    Ray generateRay(float filmX, float filmY, float lensU, float lensV) const;
+
+    /**
+     * @brief a ray for one sample of pixel (x, y), through a random point of the pixel and of the lens
+     * draws the first 4 numbers of the sample, whether or not the camera has a lens
+    */
+    CameraSample sample(int x, int y, Sampler& sampler) const;
+
+private:
+    Vec3 position;
+    // unit vectors of the view, and the view direction
+    Vec3 right, up, forward;
+    // half the extent of the film, in units of distance along the view direction
+    float halfWidth, halfHeight;
+    int width, height;
+    float aperture, focusDistance;
+};
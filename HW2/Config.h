@@ -1,4 +1,6 @@
 // Configurations for the ray tracing assignment
+// SPP, RESOLUTION, MAX_DEPTH, TIME_BUDGET, THREAD_COUNT and the paths are the defaults of the job, which a run can
+// change from its command line or a JSON job file (see Job.h)
 
 #pragma once
 
@@ -6,11 +8,102 @@
 
 
 constexpr int SPP = 512;
+// Seconds from the start of a run after which it stops adding samples, even before SPP, and writes its image; 0 for
+// no budget
+constexpr double TIME_BUDGET = 0.0;
+// Adaptive sampling: pixels take samples in batches of ADAPTIVE_BATCH, and stop before SPP once they have at least
+// ADAPTIVE_MIN_SPP and their error, as defined by Film::getError, is under ADAPTIVE_ERROR
+constexpr bool ADAPTIVE_SAMPLING = true;
+constexpr int ADAPTIVE_MIN_SPP = 64;
+constexpr int ADAPTIVE_BATCH = 32;
+constexpr float ADAPTIVE_ERROR = 0.015f;
 
+// Denoising: an edge-avoiding à-trous wavelet filter over the finished image, guided by the albedo, normal and depth
+// of the first hits. Meant for previews at 16-32 SPP; each iteration doubles the reach of the filter
+constexpr bool DENOISE = false;
+constexpr int DENOISE_ITERATIONS = 5;
+constexpr float DENOISE_SIGMA_COLOR = 4.0f;     // in standard deviations of the noise left in the pixel
+constexpr float DENOISE_SIGMA_NORMAL = 0.3f;
+constexpr float DENOISE_SIGMA_DEPTH = 1.0f;     // relative to the change of depth expected along the surface
+
+// Camera: a pinhole, or a thin lens of radius CAMERA_APERTURE focused CAMERA_FOCUS_DISTANCE away when it is not 0.
+// The field of view is vertical, in degrees; 36.87 frames the Cornell box as the assignment does
+constexpr float CAMERA_FOV = 36.87f;
+constexpr float CAMERA_APERTURE = 0.0f;
+constexpr float CAMERA_FOCUS_DISTANCE = 4.0f;
+// Reconstruction: every sample is taken at a random point of its pixel, and splatted to all the pixels whose centers
+// are within PIXEL_FILTER_RADIUS of it along both axes, weighted by the filter
+enum class PixelFilter {
+    Box,
+    Tent,
+    BlackmanHarris
+};
+constexpr PixelFilter PIXEL_FILTER = PixelFilter::BlackmanHarris;
+constexpr float PIXEL_FILTER_RADIUS = 1.5f;
+
+// Numbers of the samples: independent random numbers, or Owen-scrambled Sobol points, which cover the pixel, the
+// lens and every 2D decision along a path more evenly, and converge faster
+enum class SamplerType {
+    Independent,
+    Sobol
+};
+constexpr SamplerType SAMPLER = SamplerType::Sobol;
 constexpr int SEED = 42;
 constexpr int RESOLUTION = 512;
 constexpr int MAX_DEPTH = 8;
-constexpr float RR = 0.8f;
+constexpr float RR = 0.8f;          // highest probability for a path to survive Russian roulette
+constexpr int RR_START_DEPTH = 3;   // bounces before Russian roulette starts
+
+// The wavefront integrator traces batches of up to WAVEFRONT_BATCH_SIZE paths stage by stage, instead of one path at
+// a time per tile; both render the same image
+constexpr bool WAVEFRONT = false;
+constexpr int WAVEFRONT_BATCH_SIZE = 1 << 16;
+
+// Checkpoints: the samples are taken in rounds of CHECKPOINT_SPP per pixel, and the film is saved to CHECKPOINT_PATH
+// after each one (0: a single round, never saved). With RESUME, a render carries on from the checkpoint it finds
+// there; raising SPP then adds samples to a finished render
+constexpr int CHECKPOINT_SPP = 32;
+constexpr bool RESUME = false;
+constexpr std::string_view CHECKPOINT_PATH = "./checkpoint.bin";
+
+// Rendering is split into square tiles of this size, spread over THREAD_COUNT threads (0: one per hardware thread)
+constexpr int TILE_SIZE = 16;
+constexpr int THREAD_COUNT = 0;
+
+// Very important! Set it to 1E-9 and you'll likely see self-occlusion artifacts.
+constexpr float MIN_TRAVEL_TIME = 1e-3;
+
+// BVH construction: binned surface area heuristic over individual triangles
+constexpr int BVH_SAH_BINS = 16;
+constexpr int BVH_MIN_LEAF_SIZE = 2;        // ranges this small always become leaves
+constexpr int BVH_MAX_LEAF_SIZE = 8;        // ranges larger than this are always split
+constexpr float BVH_TRAVERSAL_COST = 1.0f;  // cost of visiting a node, relative to...
+constexpr float BVH_INTERSECT_COST = 1.0f;  // ...the cost of a ray-triangle test
+constexpr int BVH_STACK_SIZE = 64;          // traversal stack entries; also bounds the depth of the tree
+// Children per node of the traversed BVH: 2 walks the binary SAH tree, 4 and 8 collapse it and test all the child
+// boxes of a node at once, with SSE and AVX respectively. The widest the target supports, unless the build sets
+// RAYTRACING_BVH_WIDTH
+#if defined(RAYTRACING_BVH_WIDTH)
+constexpr int BVH_WIDTH = RAYTRACING_BVH_WIDTH;
+#elif defined(__AVX2__)
+constexpr int BVH_WIDTH = 8;
+#else
+constexpr int BVH_WIDTH = 4;
+#endif
+static_assert(BVH_WIDTH == 2 || BVH_WIDTH == 4 || BVH_WIDTH == 8, "BVH_WIDTH must be 2, 4 or 8");
+
+// Triangles tested together in BVH leaves, 8 with AVX and 4 with SSE
+#if defined(__AVX2__)
+constexpr int TRIANGLE_PACK_WIDTH = 8;
+#else
+constexpr int TRIANGLE_PACK_WIDTH = 4;
+#endif
+// Scenes with more emissive triangles than this sample their lights through a light BVH, by their power, distance
+// and orientation from the shading point; scenes with fewer by their power alone
+constexpr int LIGHT_BVH_THRESHOLD = 64;
+// Rays ignore the back of triangles. Off, so that open and single-sided meshes seen from behind, like the walls of
+// the Cornell box, still block rays; on only pays off for scenes made of closed meshes
+constexpr bool BACKFACE_CULLING = false;
 
 constexpr std::string_view OBJ_PATH = "./models/cornellBox/CornellBox-Original.obj";
 constexpr std::string_view MTL_SEARCH_DIR = "./models/cornellBox/";
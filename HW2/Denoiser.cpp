@@ -0,0 +1,238 @@
+#include "Denoiser.h"
+#include "Config.h"
+#include "Scheduler.h"
+#include "Simd.h"
+
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// The B3 spline, the 1D kernel of the à-trous transform; the 2D kernel is the product of two of them
+constexpr int KERNEL_RADIUS = 2;
+constexpr float KERNEL[2 * KERNEL_RADIUS + 1] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+// Albedo channels under this are left in the color, there would be nothing to multiply back
+constexpr float MIN_ALBEDO = 1e-3f;
+// Keeps the color weights finite in pixels whose samples all agreed
+constexpr float MIN_VARIANCE = 1e-6f;
+// Keeps the depth weights finite where the surface faces the camera and its depth doesn't change
+constexpr float MIN_DEPTH_CHANGE = 1e-3f;
+
+// Color channels, then the variance of their luminance
+constexpr int COLOR_PLANES = 4;
+// Normal x, y, z, depth, and the change of depth to the next pixel in x and y
+constexpr int GUIDE_PLANES = 6;
+
+/**
+ * @brief an image with one plane per channel, so neighbouring pixels of a channel load as one vector
+*/
+template<int C>
+struct Planes {
+    std::vector<float> channels[C];
+
+    explicit Planes(size_t size) {
+        for (auto& channel : channels) channel.resize(size);
+    }
+};
+
+/**
+ * @brief exp(-x) for x >= 0, approximated by (1 - x/16)^16 and 0 from x = 16 on
+ * close enough for filter weights, and only a few multiplications
+*/
+template<int W>
+SimdFloat<W> negativeExp(const SimdFloat<W>& x) {
+    using F = SimdFloat<W>;
+    F t = max(F::broadcast(1.0f) - x * F::broadcast(1.0f / 16), F::broadcast(0.0f));
+    for (int i = 0; i < 4; i++) t = t * t;
+    return t;
+}
+
+template<int W>
+SimdFloat<W> luminance(const SimdFloat<W> color[3]) {
+    using F = SimdFloat<W>;
+    return color[0] * F::broadcast(0.2126f) + color[1] * F::broadcast(0.7152f) + color[2] * F::broadcast(0.0722f);
+}
+
+/**
+ * @brief one iteration of the filter
+*/
+struct FilterPass {
+    const Planes<GUIDE_PLANES>* guide;
+    const Planes<COLOR_PLANES>* in;
+    Planes<COLOR_PLANES>* out;
+    int width, height;
+    int step;  // distance between the taps of the kernel
+    float invSigmaColor2, invSigmaNormal2, invSigmaDepth2;
+};
+
+/**
+ * @brief filter W neighbouring pixels of a row, from (x, y) on
+ * taps outside the image are left out of the sums; a block wider than one pixel has its taps all in or all out, so
+ * it must lie far enough from the left and right borders
+*/
+template<int W>
+void filterPixels(const FilterPass& pass, int x, int y) {
+    using F = SimdFloat<W>;
+    const auto& in = pass.in->channels;
+    const auto& guide = pass.guide->channels;
+    size_t center = static_cast<size_t>(y) * pass.width + x;
+
+    F color[3], normal[3];
+    for (int i = 0; i < 3; i++) {
+        color[i] = F::loadUnaligned(&in[i][center]);
+        normal[i] = F::loadUnaligned(&guide[i][center]);
+    }
+    F centerLuminance = luminance(color);
+    // differences in luminance count relative to the noise the pixel still has
+    F colorScale = F::broadcast(pass.invSigmaColor2) /
+                   max(F::loadUnaligned(&in[3][center]), F::broadcast(MIN_VARIANCE));
+    F normalScale = F::broadcast(pass.invSigmaNormal2), depthScale = F::broadcast(pass.invSigmaDepth2);
+    F depth = F::loadUnaligned(&guide[3][center]);
+    F depthChangeX = F::loadUnaligned(&guide[4][center]), depthChangeY = F::loadUnaligned(&guide[5][center]);
+
+    F sum[3] = {F::broadcast(0.0f), F::broadcast(0.0f), F::broadcast(0.0f)};
+    F varianceSum = F::broadcast(0.0f), weightSum = F::broadcast(0.0f);
+    for (int dy = -KERNEL_RADIUS; dy <= KERNEL_RADIUS; dy++) {
+        int qy = y + dy * pass.step;
+        if (qy < 0 || qy >= pass.height) continue;
+        for (int dx = -KERNEL_RADIUS; dx <= KERNEL_RADIUS; dx++) {
+            int qx = x + dx * pass.step;
+            if (qx < 0 || qx + W > pass.width) continue;
+            size_t q = static_cast<size_t>(qy) * pass.width + qx;
+
+            F tapColor[3];
+            F normalDistance = F::broadcast(0.0f);
+            for (int i = 0; i < 3; i++) {
+                tapColor[i] = F::loadUnaligned(&in[i][q]);
+                F normalDelta = F::loadUnaligned(&guide[i][q]) - normal[i];
+                normalDistance = normalDistance + normalDelta * normalDelta;
+            }
+            F luminanceDelta = luminance(tapColor) - centerLuminance;
+            // depths are compared to the plane of the pixel, relative to how fast its depth changes, so surfaces
+            // seen at grazing angles hold together while steps between surfaces stand out
+            F expectedDelta = depthChangeX * F::broadcast(static_cast<float>(qx - x)) +
+                              depthChangeY * F::broadcast(static_cast<float>(qy - y));
+            F depthDelta = F::loadUnaligned(&guide[3][q]) - depth - expectedDelta;
+            F depthRange = max(expectedDelta * expectedDelta, F::broadcast(MIN_DEPTH_CHANGE * MIN_DEPTH_CHANGE));
+
+            F weight = F::broadcast(KERNEL[dy + KERNEL_RADIUS] * KERNEL[dx + KERNEL_RADIUS]) *
+                       negativeExp(luminanceDelta * luminanceDelta * colorScale + normalDistance * normalScale +
+                                   depthDelta * depthDelta * depthScale / depthRange);
+            for (int i = 0; i < 3; i++) {
+                sum[i] = sum[i] + weight * tapColor[i];
+            }
+            varianceSum = varianceSum + weight * weight * F::loadUnaligned(&in[3][q]);
+            weightSum = weightSum + weight;
+        }
+    }
+
+    // the center tap always counts fully, so the sum of the weights is never 0
+    for (int i = 0; i < 3; i++) {
+        (sum[i] / weightSum).store(&pass.out->channels[i][center]);
+    }
+    (varianceSum / (weightSum * weightSum)).store(&pass.out->channels[3][center]);
+}
+
+/**
+ * @brief change of depth per pixel at p, from its neighbours before and after
+ * the smaller one-sided difference is taken, as the other may cross an edge; pixels that hit nothing are skipped
+*/
+float depthChange(const std::vector<float>& depth, size_t p, size_t before, size_t after) {
+    bool hasBackward = before != p && depth[before] > 0.0f, hasForward = after != p && depth[after] > 0.0f;
+    if (depth[p] <= 0.0f || (!hasBackward && !hasForward)) return 0.0f;
+    float backward = depth[p] - depth[before], forward = depth[after] - depth[p];
+    if (!hasBackward) return forward;
+    if (!hasForward) return backward;
+    return std::abs(backward) < std::abs(forward) ? backward : forward;
+}
+
+void filterTile(const FilterPass& pass, const Tile& tile) {
+    int reach = KERNEL_RADIUS * pass.step;
+    for (int y = tile.y0; y < tile.y1; y++) {
+        int x = tile.x0;
+        while (x < tile.x1) {
+            if (x + SIMD_WIDTH <= tile.x1 && x - reach >= 0 && x + SIMD_WIDTH - 1 + reach < pass.width) {
+                filterPixels<SIMD_WIDTH>(pass, x, y);
+                x += SIMD_WIDTH;
+            } else {
+                filterPixels<1>(pass, x, y);
+                x++;
+            }
+        }
+    }
+}
+
+} // namespace
+
+std::vector<Vec3> denoise(const Film& film, int threadCount) {
+    int width = film.getWidth(), height = film.getHeight();
+    size_t size = static_cast<size_t>(width) * height;
+
+    Planes<GUIDE_PLANES> guide(size);
+    Planes<COLOR_PLANES> color(size), filtered(size);
+    std::vector<Vec3> albedo(size);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t p = static_cast<size_t>(y) * width + x;
+            AOVs aovs = film.getAOVs(x, y);
+            Vec3 mean = film.getColor(x, y);
+            float a[3];
+            for (int i = 0; i < 3; i++) {
+                a[i] = aovs.albedo[i] > MIN_ALBEDO ? aovs.albedo[i] : 1.0f;
+                color.channels[i][p] = mean[i] / a[i];
+                guide.channels[i][p] = aovs.normal[i];
+            }
+            albedo[p] = Vec3(a[0], a[1], a[2]);
+            // dividing out the albedo divides the luminance by roughly the luminance of the albedo
+            float albedoLuminance = albedo[p].luminance();
+            color.channels[3][p] = film.getVariance(x, y) / (albedoLuminance * albedoLuminance);
+            guide.channels[3][p] = aovs.depth;
+        }
+    }
+    const std::vector<float>& depth = guide.channels[3];
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            size_t p = static_cast<size_t>(y) * width + x;
+            guide.channels[4][p] = depthChange(depth, p, x > 0 ? p - 1 : p, x + 1 < width ? p + 1 : p);
+            guide.channels[5][p] = depthChange(depth, p, y > 0 ? p - width : p, y + 1 < height ? p + width : p);
+        }
+    }
+
+    // the variance of a few samples is itself noisy; a 3x3 blur steadies the color weights of the first iteration
+    std::vector<float>& variance = color.channels[3];
+    std::vector<float> blurredVariance(size);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float sum = 0.0f, weightSum = 0.0f;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int qx = x + dx, qy = y + dy;
+                    if (qx < 0 || qx >= width || qy < 0 || qy >= height) continue;
+                    float weight = (dx == 0 ? 2.0f : 1.0f) * (dy == 0 ? 2.0f : 1.0f);
+                    sum += weight * variance[static_cast<size_t>(qy) * width + qx];
+                    weightSum += weight;
+                }
+            }
+            blurredVariance[static_cast<size_t>(y) * width + x] = sum / weightSum;
+        }
+    }
+    variance.swap(blurredVariance);
+
+    for (int iteration = 0; iteration < DENOISE_ITERATIONS; iteration++) {
+        FilterPass pass{&guide, &color, &filtered, width, height, 1 << iteration,
+                        1.0f / (DENOISE_SIGMA_COLOR * DENOISE_SIGMA_COLOR),
+                        1.0f / (DENOISE_SIGMA_NORMAL * DENOISE_SIGMA_NORMAL),
+                        1.0f / (DENOISE_SIGMA_DEPTH * DENOISE_SIGMA_DEPTH)};
+        renderTiles(width, height, TILE_SIZE, threadCount,
+                    [&](const Tile& tile) { filterTile(pass, tile); }, {});
+        std::swap(color, filtered);
+    }
+
+    std::vector<Vec3> image(size);
+    for (size_t p = 0; p < size; p++) {
+        image[p] = Vec3(color.channels[0][p] * albedo[p].x,
+                        color.channels[1][p] * albedo[p].y,
+                        color.channels[2][p] * albedo[p].z);
+    }
+    return image;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Film.h"
+
+#include <vector>
+
+/**
+ * @brief denoise the image of the film with an edge-avoiding à-trous wavelet filter (Dammertz et al. 2010)
+ * the albedo is divided out before filtering and multiplied back afterwards, so textures stay sharp; the weights
+ * between pixels fall off with their differences in normal and depth, so edges do too, and in luminance relative to
+ * the variance the film measured, so only noise is smoothed out (as in SVGF, Schied et al. 2017)
+ * @param threadCount: as for renderTiles
+ * @return the denoised image, row by row
+*/
+std::vector<Vec3> denoise(const Film& film, int threadCount);
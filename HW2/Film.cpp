@@ -0,0 +1,261 @@
+#include "Film.h"
+#include "Config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+// Most pixels the filter reaches from a sample on either side of its own, along each axis
+constexpr int FILTER_REACH = static_cast<int>(PIXEL_FILTER_RADIUS + 0.5f);
+
+/**
+ * @brief the reconstruction filter along one axis, at `offset` pixels from the sample, within PIXEL_FILTER_RADIUS
+*/
+float filterWeight(float offset) {
+    switch (PIXEL_FILTER) {
+        case PixelFilter::Box:
+            return 1.0f;
+        case PixelFilter::Tent:
+            return PIXEL_FILTER_RADIUS - std::abs(offset);
+        case PixelFilter::BlackmanHarris: {
+            // the window over [-radius, radius], 1 in the middle
+            float t = PI * (offset / PIXEL_FILTER_RADIUS + 1);
+            return 0.35875f - 0.48829f * std::cos(t) + 0.14128f * std::cos(2 * t) - 0.01168f * std::cos(3 * t);
+        }
+    }
+    return 0.0f;
+}
+
+/**
+ * @brief the start of a checkpoint file, followed by the pixels row by row, as they are in memory
+ * everything in it is 4 bytes wide, in the byte order of the machine that wrote it
+*/
+struct CheckpointHeader {
+    char magic[8] = {'H', 'W', '2', 'F', 'I', 'L', 'M', '\0'};
+    uint32_t version = 2;
+    int32_t width = 0, height = 0;
+    uint32_t firstSample = 0;
+    // what the samples were taken with; more samples only add up with the same ones
+    uint32_t seed = SEED;
+    uint32_t sampler = static_cast<uint32_t>(SAMPLER);
+    uint32_t filter = static_cast<uint32_t>(PIXEL_FILTER);
+    float filterRadius = PIXEL_FILTER_RADIUS;
+};
+
+/**
+ * @brief read the header of a checkpoint, and check it was written by a render with the settings of this build
+ * @return false, after printing why, if it can't be read or was not
+*/
+bool readHeader(std::ifstream& file, const std::filesystem::path& path, CheckpointHeader& header) {
+    CheckpointHeader expected;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        std::cerr << "Checkpoint " << path << " can't be read.\n";
+        return false;
+    }
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version) {
+        std::cerr << "Checkpoint " << path << " is not a checkpoint of this renderer.\n";
+        return false;
+    }
+    // the size and the first sample are the film's own
+    expected.width = header.width;
+    expected.height = header.height;
+    expected.firstSample = header.firstSample;
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0 || header.width <= 0 || header.height <= 0) {
+        std::cerr << "Checkpoint " << path << " belongs to another render: it is " << header.width << "x"
+                  << header.height << ", with seed " << header.seed << ", sampler " << header.sampler << " and filter "
+                  << header.filter << " of radius " << header.filterRadius << ".\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+FilmTile::FilmTile(const Film &film, int x0, int y0, int x1, int y1)
+    : x0(std::max(x0 - FILTER_REACH, 0)), y0(std::max(y0 - FILTER_REACH, 0)),
+      x1(std::min(x1 + FILTER_REACH, film.getWidth())), y1(std::min(y1 + FILTER_REACH, film.getHeight())) {
+    size_t size = static_cast<size_t>(this->x1 - this->x0) * (this->y1 - this->y0);
+    weightedSums.resize(size);
+    weights.resize(size);
+}
+
+void FilmTile::addSample(float filmX, float filmY, const Vec3 &value) {
+    // the pixels whose centers are within the radius
+    int px0 = std::max(static_cast<int>(std::ceil(filmX - 0.5f - PIXEL_FILTER_RADIUS)), x0);
+    int px1 = std::min(static_cast<int>(std::floor(filmX - 0.5f + PIXEL_FILTER_RADIUS)) + 1, x1);
+    int py0 = std::max(static_cast<int>(std::ceil(filmY - 0.5f - PIXEL_FILTER_RADIUS)), y0);
+    int py1 = std::min(static_cast<int>(std::floor(filmY - 0.5f + PIXEL_FILTER_RADIUS)) + 1, y1);
+    if (px0 >= px1 || py0 >= py1) return;
+
+    // the filter is separable: one weight per column and one per row
+    float weightsX[2 * FILTER_REACH + 1], weightsY[2 * FILTER_REACH + 1];
+    for (int x = px0; x < px1; x++) {
+        weightsX[x - px0] = filterWeight(x + 0.5f - filmX);
+    }
+    for (int y = py0; y < py1; y++) {
+        weightsY[y - py0] = filterWeight(y + 0.5f - filmY);
+    }
+    for (int y = py0; y < py1; y++) {
+        size_t row = static_cast<size_t>(y - y0) * (x1 - x0) - x0;
+        for (int x = px0; x < px1; x++) {
+            float weight = weightsX[x - px0] * weightsY[y - py0];
+            weightedSums[row + x] += value * weight;
+            weights[row + x] += weight;
+        }
+    }
+}
+
+Film::Film(int width, int height, uint32_t firstSample)
+    : width(width), height(height), firstSample(firstSample), pixels(static_cast<size_t>(width) * height) {
+}
+
+void Film::addSample(int x, int y, const Vec3 &value, const AOVs &aovs) {
+    Pixel& pixel = pixels[static_cast<size_t>(y) * width + x];
+    pixel.count++;
+    float weight = 1.0f / pixel.count;
+    pixel.mean += (value - pixel.mean) * weight;
+
+    float luminance = value.luminance();
+    float delta = luminance - pixel.luminanceMean;
+    pixel.luminanceMean += delta * weight;
+    pixel.luminanceM2 += delta * (luminance - pixel.luminanceMean);
+
+    pixel.aovs.albedo += (aovs.albedo - pixel.aovs.albedo) * weight;
+    pixel.aovs.normal += (aovs.normal - pixel.aovs.normal) * weight;
+    pixel.aovs.depth += (aovs.depth - pixel.aovs.depth) * weight;
+}
+
+void Film::mergeTile(const FilmTile &tile) {
+    std::lock_guard<std::mutex> lock(mergeMutex);
+    for (int y = tile.y0; y < tile.y1; y++) {
+        for (int x = tile.x0; x < tile.x1; x++) {
+            size_t index = static_cast<size_t>(y - tile.y0) * (tile.x1 - tile.x0) + (x - tile.x0);
+            Pixel& pixel = pixels[static_cast<size_t>(y) * width + x];
+            pixel.weightedSum += tile.weightedSums[index];
+            pixel.weight += tile.weights[index];
+        }
+    }
+}
+
+void Film::merge(const Film &other) {
+    for (size_t i = 0; i < pixels.size(); i++) {
+        Pixel& pixel = pixels[i];
+        const Pixel& otherPixel = other.pixels[i];
+        pixel.weightedSum += otherPixel.weightedSum;
+        pixel.weight += otherPixel.weight;
+        if (otherPixel.count == 0) continue;
+
+        // the means move towards the other ones by the share of the other samples (Chan et al. 1979)
+        uint32_t count = pixel.count + otherPixel.count;
+        float weight = static_cast<float>(otherPixel.count) / count;
+        pixel.mean += (otherPixel.mean - pixel.mean) * weight;
+        float delta = otherPixel.luminanceMean - pixel.luminanceMean;
+        pixel.luminanceMean += delta * weight;
+        pixel.luminanceM2 += otherPixel.luminanceM2 + delta * delta * pixel.count * weight;
+        pixel.aovs.albedo += (otherPixel.aovs.albedo - pixel.aovs.albedo) * weight;
+        pixel.aovs.normal += (otherPixel.aovs.normal - pixel.aovs.normal) * weight;
+        pixel.aovs.depth += (otherPixel.aovs.depth - pixel.aovs.depth) * weight;
+        pixel.count = count;
+    }
+}
+
+Vec3 Film::getColor(int x, int y) const {
+    const Pixel& pixel = pixels[static_cast<size_t>(y) * width + x];
+    if (pixel.weight <= 0.0f) return pixel.mean;
+    return pixel.weightedSum / pixel.weight;
+}
+
+Vec3 Film::getMean(int x, int y) const {
+    return pixels[static_cast<size_t>(y) * width + x].mean;
+}
+
+AOVs Film::getAOVs(int x, int y) const {
+    return pixels[static_cast<size_t>(y) * width + x].aovs;
+}
+
+uint32_t Film::getSampleCount(int x, int y) const {
+    return pixels[static_cast<size_t>(y) * width + x].count;
+}
+
+uint32_t Film::getFirstSample() const {
+    return firstSample;
+}
+
+float Film::getError(int x, int y) const {
+    const Pixel& pixel = pixels[static_cast<size_t>(y) * width + x];
+    if (pixel.count < 2) return std::numeric_limits<float>::max();
+    if (pixel.luminanceMean <= 0.0f) return 0.0f;
+    return std::sqrt(getVariance(x, y) / pixel.luminanceMean);
+}
+
+float Film::getVariance(int x, int y) const {
+    const Pixel& pixel = pixels[static_cast<size_t>(y) * width + x];
+    if (pixel.count < 2) return 0.0f;
+    return pixel.luminanceM2 / (pixel.count - 1) / pixel.count;
+}
+
+bool Film::isConverged(int x, int y, uint32_t minSamples, float maxError) const {
+    return getSampleCount(x, y) >= minSamples && getError(x, y) < maxError;
+}
+
+bool Film::save(const std::filesystem::path &path) const {
+    static_assert(std::is_trivially_copyable_v<Pixel>);
+    CheckpointHeader header;
+    header.width = width;
+    header.height = height;
+    header.firstSample = firstSample;
+
+    // a crash while writing leaves the last checkpoint as it was
+    std::filesystem::path partPath = path;
+    partPath += ".part";
+    {
+        std::ofstream file(partPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size() * sizeof(Pixel)));
+        if (!file) return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(partPath, path, error);
+    return !error;
+}
+
+bool Film::load(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    CheckpointHeader header;
+    if (!readHeader(file, path, header)) return false;
+    if (header.width != width || header.height != height) {
+        std::cerr << "Checkpoint " << path << " is " << header.width << "x" << header.height << ", not " << width
+                  << "x" << height << ".\n";
+        return false;
+    }
+    if (!file.read(reinterpret_cast<char*>(pixels.data()), static_cast<std::streamsize>(pixels.size() * sizeof(Pixel)))) {
+        std::cerr << "Checkpoint " << path << " is cut short.\n";
+        return false;
+    }
+    firstSample = header.firstSample;
+    return true;
+}
+
+bool Film::readCheckpointInfo(const std::filesystem::path &path, int &width, int &height, uint32_t &firstSample) {
+    std::ifstream file(path, std::ios::binary);
+    CheckpointHeader header;
+    if (!readHeader(file, path, header)) return false;
+    width = header.width;
+    height = header.height;
+    firstSample = header.firstSample;
+    return true;
+}
+
+int Film::getWidth() const {
+    return width;
+}
+
+int Film::getHeight() const {
+    return height;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Math.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief features of the surface first hit by a camera ray, which guide the denoiser
+ * all zero when the ray hits nothing
+*/
+struct AOVs {
+    Vec3 albedo;
+    Vec3 normal;
+    float depth = 0.0f;
+};
+
+class Film;
+
+/**
+ * @brief the samples taken in a rectangle of pixels, splatted through the reconstruction filter
+ * the filter reaches past the rectangle, so the tile keeps the pixels around it as well, until it is merged into the
+ * film; a worker can then splat freely into its own tile
+*/
+class FilmTile {
+public:
+    /**
+     * @brief a tile for the samples of the pixels [x0, x1) x [y0, y1) of the film
+    */
+    FilmTile(const Film& film, int x0, int y0, int x1, int y1);
+
+    /**
+     * @brief add the sample taken at (filmX, filmY), in pixels, to every pixel the filter reaches from there
+     * the weight is the filter at the offset of the pixel center, once along x and once along y
+    */
+    void addSample(float filmX, float filmY, const Vec3& value);
+
+private:
+    friend class Film;
+
+    // the pixels kept, the rectangle and the reach of the filter around it, within the film
+    int x0, y0, x1, y1;
+    std::vector<Vec3> weightedSums;
+    std::vector<float> weights;
+};
+
+/**
+ * @brief the pixels of the image being rendered, with running statistics of their samples
+ * the mean and the variance of the samples taken in each pixel are updated with Welford's algorithm, so the samples
+ * themselves are not kept. The image itself is reconstructed from the samples splatted through the filter
+ * @note different threads may add samples to different pixels at the same time, and merge tiles at any time
+*/
+class Film {
+public:
+    /**
+     * @param firstSample: index of the first sample of every pixel; a film may hold a range of the samples of a
+     * frame, and the pixels take the sample indices from there on
+    */
+    Film(int width, int height, uint32_t firstSample = 0);
+
+    void addSample(int x, int y, const Vec3& value, const AOVs& aovs);
+    /**
+     * @brief add the splatted samples of the tile to the image
+    */
+    void mergeTile(const FilmTile& tile);
+    /**
+     * @brief add the samples of another film of the same size, as if they had been taken into this one
+     * meant for films holding different pixels or different ranges of samples of a frame; the statistics of every
+     * pixel are combined by their sample counts
+    */
+    void merge(const Film& other);
+
+    /**
+     * @brief the pixel of the image: the filtered average of the samples around it
+     * the plain mean of its own samples until any of them is merged
+    */
+    Vec3 getColor(int x, int y) const;
+    Vec3 getMean(int x, int y) const;
+    /**
+     * @brief the mean of the AOVs of the samples of the pixel
+    */
+    AOVs getAOVs(int x, int y) const;
+    uint32_t getSampleCount(int x, int y) const;
+    uint32_t getFirstSample() const;
+    /**
+     * @brief standard error of the mean luminance of the pixel, relative to the square root of that mean
+     * the square root follows the noise visible after the display gamma much better than the mean itself, which
+     * would keep sampling dark pixels whose noise doesn't show
+     * 0 for pixels with no light at all, which have nothing left to converge
+    */
+    float getError(int x, int y) const;
+    /**
+     * @brief variance of the mean luminance of the pixel, 0 while it has less than 2 samples
+    */
+    float getVariance(int x, int y) const;
+    /**
+     * @brief whether the pixel has at least `minSamples` samples and an error under `maxError`
+    */
+    bool isConverged(int x, int y, uint32_t minSamples, float maxError) const;
+
+    /**
+     * @brief write everything the film keeps to a binary checkpoint, replacing the file only once it is complete
+     * the samplers are counter based, so the sample counts of the pixels are all the state they need to carry on
+     * @return false if the file can't be written
+    */
+    bool save(const std::filesystem::path& path) const;
+    /**
+     * @brief replace the contents of the film with a checkpoint written by save, including its first sample
+     * @return false, after printing why, if the file can't be read or was written by a render of another size, seed,
+     * sampler or reconstruction filter
+    */
+    bool load(const std::filesystem::path& path);
+    /**
+     * @brief the size and the first sample of the film in a checkpoint written by save, without reading its pixels
+     * @return false, after printing why, if the file can't be read or was written by a render of another seed,
+     * sampler or reconstruction filter
+    */
+    static bool readCheckpointInfo(const std::filesystem::path& path, int& width, int& height, uint32_t& firstSample);
+
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    struct Pixel {
+        Vec3 mean;
+        float luminanceMean = 0.0f;
+        // sum of the squared differences of the luminances to their mean
+        float luminanceM2 = 0.0f;
+        uint32_t count = 0;
+        AOVs aovs;
+        // the samples splatted to the pixel, each weighted by the filter, and the sum of their weights
+        Vec3 weightedSum;
+        float weight = 0.0f;
+    };
+
+    int width, height;
+    uint32_t firstSample;
+    std::vector<Pixel> pixels;
+    std::mutex mergeMutex;
+};
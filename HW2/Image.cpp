@@ -0,0 +1,56 @@
+#include "Image.h"
+#include "Config.h"
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+constexpr float GAMMA = 0.6f;
+
+namespace {
+
+unsigned char toLinear(float sRGB) {
+    return 255 * std::pow(std::clamp(sRGB, 0.0f, 1.0f), GAMMA);
+}
+
+} // namespace
+
+std::vector<Vec3> developImage(const Film& film, int threadCount) {
+    using namespace std::chrono;
+    int width = film.getWidth(), height = film.getHeight();
+    std::vector<Vec3> image;
+    if constexpr(DENOISE) {
+        auto denoiseStart = high_resolution_clock::now();
+        image = denoise(film, threadCount);
+        std::cout << "Denoising time in milliseconds: "
+                  << duration_cast<milliseconds>(high_resolution_clock::now() - denoiseStart).count() << '\n';
+    } else {
+        image.reserve(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                image.push_back(film.getColor(x, y));
+            }
+        }
+    }
+    return image;
+}
+
+bool writePPM(const std::filesystem::path& path, int width, int height, const std::vector<Vec3>& image) {
+    FILE* fp = fopen(path.string().c_str(), "wb");
+    if (!fp) return false;
+    (void)fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char color[3];
+            const Vec3& value = image[static_cast<size_t>(y) * width + x];
+            color[0] = toLinear(value.x);
+            color[1] = toLinear(value.y);
+            color[2] = toLinear(value.z);
+            fwrite(color, 1, 3, fp);
+        }
+    }
+    return fclose(fp) == 0;
+}
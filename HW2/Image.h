@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Film.h"
+
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief the final image of the film, row by row: denoised with DENOISE, its filtered pixels otherwise
+ * @param threadCount: as for renderTiles
+*/
+std::vector<Vec3> developImage(const Film& film, int threadCount);
+
+/**
+ * @brief write the image as a binary PPM, gamma corrected
+ * @return false if the file can't be written
+*/
+bool writePPM(const std::filesystem::path& path, int width, int height, const std::vector<Vec3>& image);
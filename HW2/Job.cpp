@@ -0,0 +1,227 @@
+#include "Job.h"
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Options = std::vector<std::pair<std::string, std::vector<std::string>>>;
+
+/**
+ * @brief reads a JSON object whose values are strings, numbers or arrays of them, all as text
+*/
+class JSONReader {
+public:
+    explicit JSONReader(const std::string& text) : text(text) {}
+
+    bool readObject(Options& options) {
+        if (!consume('{')) return false;
+        if (consume('}')) return atEnd();
+        do {
+            std::string name;
+            if (!readString(name) || !consume(':')) return false;
+            std::vector<std::string> values;
+            if (consume('[')) {
+                if (!consume(']')) {
+                    do {
+                        values.emplace_back();
+                        if (!readScalar(values.back())) return false;
+                    } while (consume(','));
+                    if (!consume(']')) return false;
+                }
+            } else {
+                values.emplace_back();
+                if (!readScalar(values.back())) return false;
+            }
+            options.emplace_back(std::move(name), std::move(values));
+        } while (consume(','));
+        return consume('}') && atEnd();
+    }
+
+private:
+    void skipSpace() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) position++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (position >= text.size() || text[position] != c) return false;
+        position++;
+        return true;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return position == text.size();
+    }
+
+    bool readString(std::string& value) {
+        if (!consume('"')) return false;
+        for (; position < text.size(); position++) {
+            char c = text[position];
+            if (c == '"') {
+                position++;
+                return true;
+            }
+            if (c == '\\') {
+                if (++position >= text.size()) return false;
+                switch (text[position]) {
+                    case '"': case '\\': case '/': value += text[position]; break;
+                    case 'n': value += '\n'; break;
+                    case 't': value += '\t'; break;
+                    default: return false;
+                }
+            } else {
+                value += c;
+            }
+        }
+        return false;
+    }
+
+    bool readScalar(std::string& value) {
+        skipSpace();
+        if (position < text.size() && text[position] == '"') return readString(value);
+        // a number, left for the option to convert
+        size_t start = position;
+        while (position < text.size() && (std::isdigit(static_cast<unsigned char>(text[position])) ||
+                                          std::string_view("+-.eE").find(text[position]) != std::string_view::npos)) {
+            position++;
+        }
+        value = text.substr(start, position - start);
+        return !value.empty();
+    }
+
+    const std::string& text;
+    size_t position = 0;
+};
+
+/**
+ * @brief set one option of the job
+ * @return false, after printing why, if there is no such option or its values don't fit it
+*/
+bool setOption(Job& job, const std::string& name, const std::vector<std::string>& values) {
+    auto expect = [&](size_t count) {
+        if (values.size() == count) return true;
+        std::cerr << "Option " << name << " takes " << count << (count == 1 ? " value" : " values") << ".\n";
+        return false;
+    };
+    try {
+        if (name == "scene") {
+            if (!expect(1)) return false;
+            job.scenePath = values[0];
+        } else if (name == "materials") {
+            if (!expect(1)) return false;
+            job.materialDir = values[0];
+        } else if (name == "output") {
+            if (!expect(1)) return false;
+            job.outputPath = values[0];
+        } else if (name == "resolution") {
+            if (!expect(1)) return false;
+            job.resolution = std::stoi(values[0]);
+        } else if (name == "spp") {
+            if (!expect(1)) return false;
+            job.spp = std::stoi(values[0]);
+        } else if (name == "max-depth") {
+            if (!expect(1)) return false;
+            job.maxDepth = std::stoi(values[0]);
+        } else if (name == "time-budget") {
+            if (!expect(1)) return false;
+            job.timeBudget = std::stod(values[0]);
+        } else if (name == "threads") {
+            if (!expect(1)) return false;
+            job.threadCount = std::stoi(values[0]);
+        } else if (name == "tiles") {
+            if (!expect(2)) return false;
+            job.tileBegin = std::stoi(values[0]);
+            job.tileEnd = std::stoi(values[1]);
+        } else if (name == "samples") {
+            if (!expect(2)) return false;
+            job.sampleBegin = std::stoi(values[0]);
+            job.sampleEnd = std::stoi(values[1]);
+        } else if (name == "partial") {
+            if (!expect(1)) return false;
+            job.partialPath = values[0];
+        } else {
+            std::cerr << "Unknown option " << name << ".\n";
+            return false;
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Option " << name << " takes numbers.\n";
+        return false;
+    }
+    return true;
+}
+
+bool readJobFile(const std::filesystem::path& path, Job& job) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Job file " << path << " can't be read.\n";
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string contents = text.str();
+    Options options;
+    if (!JSONReader(contents).readObject(options)) {
+        std::cerr << "Job file " << path << " is not a JSON object of strings, numbers and arrays of them.\n";
+        return false;
+    }
+    for (const auto& [name, values] : options) {
+        if (!setOption(job, name, values)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool parseJob(int argc, char* argv[], Job& job) {
+    // the options of the command line, each with the values up to the next one
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            options.emplace_back(arg.substr(2), std::vector<std::string>());
+        } else if (!options.empty()) {
+            options.back().second.push_back(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--job FILE] [--OPTION VALUE...]..., with the options of Job.h\n";
+            return false;
+        }
+    }
+
+    // the job file first, whatever its place, for the command line to override
+    for (const auto& [name, values] : options) {
+        if (name != "job") continue;
+        if (values.size() != 1) {
+            std::cerr << "Option job takes 1 value.\n";
+            return false;
+        }
+        if (!readJobFile(values[0], job)) return false;
+    }
+    for (const auto& [name, values] : options) {
+        if (name != "job" && !setOption(job, name, values)) return false;
+    }
+
+    if (job.spp == 0) job.spp = job.timeBudget > 0 ? std::numeric_limits<int>::max() : SPP;
+    if (job.sampleEnd < 0) job.sampleEnd = job.spp;
+    if (job.resolution <= 0 || job.spp <= 0 || job.threadCount < 0 || job.maxDepth < 0 || job.timeBudget < 0) {
+        std::cerr << "The resolution and spp must be positive, the threads, max-depth and time-budget not negative.\n";
+        return false;
+    }
+    if (job.tileBegin < 0 || job.tileBegin > job.tileEnd || job.sampleBegin < 0 || job.sampleBegin > job.sampleEnd) {
+        std::cerr << "The tiles and samples must be ranges [BEGIN, END) of indices.\n";
+        return false;
+    }
+    bool coversFrame = job.tileBegin == 0 && job.tileEnd == std::numeric_limits<int>::max() &&
+                       job.sampleBegin == 0 && job.sampleEnd == job.spp;
+    if (!coversFrame && !job.isPartial()) {
+        std::cerr << "A part of the frame needs --partial PATH to be written to.\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Config.h"
+
+#include <filesystem>
+#include <limits>
+#include <string>
+
+/**
+ * @brief what a run of the renderer does, read when it starts
+ * it starts from the defaults of Config.h; a JSON job file given with --job overrides them, and the other options of
+ * the command line override both. The options, as `--name VALUE...` or `"name": VALUE` / `"name": [VALUE, ...]`:
+ *   scene PATH, materials DIR, output PATH: the OBJ file, the directory of its MTL files, the image written
+ *   resolution N, spp N, max-depth N: width and height of the image, samples per pixel, bounces per path
+ *   time-budget SECONDS: stop adding samples when the next round would end later than that after the start, and
+ *     write the image as it is then; 0 for no budget. With a budget, spp and samples are only upper limits, and
+ *     without either of them the samples go on until the time is up
+ *   threads N: as THREAD_COUNT
+ *   tiles BEGIN END, samples BEGIN END, partial PATH: render only those tiles and samples of the frame, into the
+ *     partial film PATH, for RayTracingMerge
+*/
+struct Job {
+    std::string scenePath = std::string(OBJ_PATH);
+    std::string materialDir = std::string(MTL_SEARCH_DIR);
+    std::filesystem::path outputPath = OUTPUT_PATH;
+    int resolution = RESOLUTION;
+    // 0 until set: SPP without a time budget, no limit with one
+    int spp = 0;
+    int maxDepth = MAX_DEPTH;
+    double timeBudget = TIME_BUDGET;
+    int threadCount = THREAD_COUNT;
+
+    // tiles of renderTiles, counted row by row
+    int tileBegin = 0, tileEnd = std::numeric_limits<int>::max();
+    // indices of the samples of every pixel; up to spp when not set
+    int sampleBegin = 0, sampleEnd = -1;
+    // the partial film; empty when rendering the whole frame
+    std::filesystem::path partialPath;
+
+    bool isPartial() const {
+        return !partialPath.empty();
+    }
+};
+
+/**
+ * @brief read the job from the command line, and from the JSON file it names with --job
+ * @return false, after printing why, if they can't be read or don't make a job
+*/
+bool parseJob(int argc, char* argv[], Job& job);
@@ -0,0 +1,187 @@
+#include "LightSampler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// The largest float below 1, to keep the reused uniform numbers in [0, 1)
+constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+namespace {
+
+/**
+ * @brief the smallest cone holding two cones of directions, each given by its axis and the cosine of its half angle
+*/
+void coneUnion(Vec3& axis, float& cosTheta, const Vec3& otherAxis, float otherCosTheta) {
+    float theta = std::acos(std::clamp(cosTheta, -1.0f, 1.0f));
+    float otherTheta = std::acos(std::clamp(otherCosTheta, -1.0f, 1.0f));
+    float between = std::acos(std::clamp(axis.dot(otherAxis), -1.0f, 1.0f));
+    if (std::min(between + otherTheta, PI) <= theta) return;
+    if (std::min(between + theta, PI) <= otherTheta) {
+        axis = otherAxis;
+        cosTheta = otherCosTheta;
+        return;
+    }
+
+    float unionTheta = (theta + between + otherTheta) / 2;
+    Vec3 rotationAxis = axis.cross(otherAxis);
+    if (unionTheta >= PI || rotationAxis.getLength() == 0.0f) {
+        // every direction
+        cosTheta = -1.0f;
+        return;
+    }
+    // turn the axis towards the other one until the cone reaches around both (Rodrigues' rotation)
+    rotationAxis.normalize();
+    float rotation = unionTheta - theta;
+    axis = axis * std::cos(rotation) + rotationAxis.cross(axis) * std::sin(rotation);
+    axis.normalize();
+    cosTheta = std::cos(unionTheta);
+}
+
+/**
+ * @brief cos(max(0, a - b)) from the cosines of a and b and the sine of b, with a and b in [0, pi]
+*/
+float cosSubtractClamped(float cosA, float cosB, float sinB) {
+    if (cosA >= cosB) return 1.0f;
+    float sinA = std::sqrt(std::max(0.0f, 1.0f - cosA * cosA));
+    return cosA * cosB + sinA * sinB;
+}
+
+} // namespace
+
+float LightSampler::LightNode::importance(const Vec3 &pos, const Vec3 &normal) const {
+    Vec3 toPoint = pos - center;
+    float distance2 = toPoint.dot(toPoint);
+    // from inside the bounding sphere every direction may lead to an emitter
+    if (distance2 <= radius2) return power / radius2;
+    Vec3 dir = toPoint / std::sqrt(distance2);
+
+    // the angle the bounding sphere spans from the point
+    float sin2Bound = radius2 / distance2;
+    float cosBound = std::sqrt(1.0f - sin2Bound), sinBound = std::sqrt(sin2Bound);
+
+    // the smallest angle between the emitters' normals and the direction to the point; the lights only emit
+    // from their front face, so nothing reaches the point past 90 degrees
+    float cosEmit = cosSubtractClamped(axis.dot(dir), cosTheta, sinTheta);
+    cosEmit = cosSubtractClamped(cosEmit, cosBound, sinBound);
+    if (cosEmit <= 0.0f) return 0.0f;
+
+    // the smallest angle between the normal at the point and the lights
+    float cosReceive = cosSubtractClamped(std::abs(normal.dot(dir)), cosBound, sinBound);
+    return power * cosEmit * cosReceive / distance2;
+}
+
+void LightSampler::build(const std::vector<Object*> &lights) {
+    emitters.clear();
+    nodes.clear();
+    powerTable = AliasTable();
+    for (const Object* light : lights) {
+        float radiance = light->ke.luminance();
+        for (const Mesh& mesh : light->meshes) {
+            emitters.push_back({&mesh, light, radiance * mesh.area});
+        }
+    }
+    if (emitters.empty()) return;
+
+    if (emitters.size() <= static_cast<size_t>(LIGHT_BVH_THRESHOLD)) {
+        std::vector<float> powers;
+        powers.reserve(emitters.size());
+        for (const Emitter& emitter : emitters) {
+            powers.push_back(emitter.power);
+        }
+        powerTable = AliasTable(powers);
+    } else {
+        nodes.reserve(2 * emitters.size() - 1);
+        buildNode(0, static_cast<uint32_t>(emitters.size()));
+    }
+}
+
+uint32_t LightSampler::buildNode(uint32_t begin, uint32_t end) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    LightNode node;
+    BoundingBox bounds = BoundingBox::empty();
+    BoundingBox centroids = BoundingBox::empty();
+    for (uint32_t i = begin; i < end; i++) {
+        const Emitter& emitter = emitters[i];
+        BoundingBox box = BoundingBox::constructFromMesh(*emitter.mesh);
+        bounds.boxUnion(box);
+        centroids.boxUnion(box.centroid());
+        if (i == begin) {
+            node.axis = emitter.mesh->normal;
+            node.cosTheta = 1.0f;
+        } else {
+            coneUnion(node.axis, node.cosTheta, emitter.mesh->normal, 1.0f);
+        }
+        node.power += emitter.power;
+    }
+    node.center = bounds.centroid();
+    Vec3 diagonal = bounds.diagonal();
+    // a single flat triangle still needs some extent for the importance, which divides by it up close
+    node.radius2 = std::max(diagonal.dot(diagonal) / 4, 1e-8f);
+    node.sinTheta = std::sqrt(std::max(0.0f, 1.0f - node.cosTheta * node.cosTheta));
+
+    if (end - begin == 1) {
+        node.isLeaf = true;
+        node.offset = begin;
+    } else {
+        // split at the median along the widest spread of the centroids
+        int axis = static_cast<int>(centroids.maxExtent());
+        uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(emitters.begin() + begin, emitters.begin() + middle, emitters.begin() + end,
+                         [axis](const Emitter& e1, const Emitter& e2) {
+                             return BoundingBox::constructFromMesh(*e1.mesh).centroid()[axis] <
+                                    BoundingBox::constructFromMesh(*e2.mesh).centroid()[axis];
+                         });
+        buildNode(begin, middle);
+        node.offset = buildNode(middle, end);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+LightSample LightSampler::sample(const Vec3 &pos, const Vec3 &normal, Sampler &sampler) const {
+    assert (!empty());
+    float u = sampler.get1D();
+    uint32_t emitterIndex;
+    float pmf;
+    if (nodes.empty()) {
+        emitterIndex = powerTable.sample(u);
+        pmf = powerTable.pmf(emitterIndex);
+    } else {
+        // descend by importance; the number picking a child is rescaled to pick the next one
+        uint32_t current = 0;
+        pmf = 1.0f;
+        while (!nodes[current].isLeaf) {
+            uint32_t first = current + 1, second = nodes[current].offset;
+            float firstImportance = nodes[first].importance(pos, normal);
+            float secondImportance = nodes[second].importance(pos, normal);
+            if (firstImportance + secondImportance <= 0.0f) return {};
+            float firstProbability = firstImportance / (firstImportance + secondImportance);
+            if (u < firstProbability) {
+                u = std::min(u / firstProbability, ONE_MINUS_EPSILON);
+                pmf *= firstProbability;
+                current = first;
+            } else {
+                u = std::min((u - firstProbability) / (1.0f - firstProbability), ONE_MINUS_EPSILON);
+                pmf *= 1.0f - firstProbability;
+                current = second;
+            }
+        }
+        emitterIndex = nodes[current].offset;
+    }
+
+    const Emitter& emitter = emitters[emitterIndex];
+    LightSample result;
+    result.point.happened = true;
+    result.point.mesh = emitter.mesh;
+    result.point.object = emitter.object;
+    result.point.pos = emitter.mesh->sample(sampler);
+    result.pdf = pmf / emitter.mesh->area;
+    return result;
+}
+
+bool LightSampler::empty() const {
+    return emitters.empty();
+}
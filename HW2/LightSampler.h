@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Accel.h"
+#include "AliasTable.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief a point sampled on a light, and the probability density of sampling it, per unit area
+ * the density is 0 when no light can reach the shading point
+*/
+struct LightSample {
+    Intersection point;
+    float pdf = 0.0f;
+};
+
+/**
+ * @brief samples points on all the emissive triangles of the scene, for direct lighting
+ * up to LIGHT_BVH_THRESHOLD triangles are picked by their emitted power, from an alias table. More go into a light
+ * BVH, which is walked down towards the lights that matter most to the shading point, by their power, distance and
+ * orientation (Conty Estevez and Kulla 2018)
+*/
+class LightSampler {
+public:
+    void build(const std::vector<Object*>& lights);
+
+    /**
+     * @brief sample a point on a light to shade the surface at `pos`, facing `normal`
+    */
+    LightSample sample(const Vec3& pos, const Vec3& normal, Sampler& sampler) const;
+
+    bool empty() const;
+
+private:
+    struct Emitter {
+        const Mesh* mesh = nullptr;
+        const Object* object = nullptr;
+        float power = 0.0f;
+    };
+
+    /**
+     * @brief a node of the light BVH, bounding the emitters under it in space and in direction
+     * an interior node has its first child right after it; a leaf holds a single emitter
+    */
+    struct LightNode {
+        // the bounding sphere of the bounding box of the emitters
+        Vec3 center;
+        float radius2 = 0.0f;
+        // the normals of the emitters lie within acos(cosTheta) of the axis
+        Vec3 axis;
+        float cosTheta = 1.0f, sinTheta = 0.0f;
+        float power = 0.0f;
+        uint32_t offset = 0;  // second child of an interior node, emitter of a leaf
+        bool isLeaf = false;
+
+        /**
+         * @brief an upper bound of the light the emitters under the node can send to the shading point
+         * 0 only when none of them can reach it
+        */
+        float importance(const Vec3& pos, const Vec3& normal) const;
+    };
+
+    /**
+     * @brief build the node over emitters[begin, end) and all the nodes under it
+     * @return the index of the node
+    */
+    uint32_t buildNode(uint32_t begin, uint32_t end);
+
+    std::vector<Emitter> emitters;
+    AliasTable powerTable;
+    std::vector<LightNode> nodes;
+};
@@ -106,15 +106,16 @@ Vec3 Vec3::cross(const Vec3& v) const {
         z /= len;
     }
 
-float Vec3::dot(const Vec3& v) const {
-    return x * v.x + y * v.y + z * v.z;
+float Vec3::operator[](int axis) const {
+    return axis == 0 ? x : (axis == 1 ? y : z);
 }
 
-std::mt19937 Random::generator(SEED);
-std::uniform_real_distribution<float> Random::distribution {0.0f, 1.0f};
+float Vec3::luminance() const {
+    return 0.2126f * x + 0.7152f * y + 0.0722f * z;
+}
 
-float Random::randUniformFloat() {
-    return distribution(generator);
+float Vec3::dot(const Vec3& v) const {
+    return x * v.x + y * v.y + z * v.z;
 }
 
 Vec3 localDirToWorld(const Vec3& direction, const Vec3& normal) {
@@ -138,13 +139,12 @@ Vec3 localDirToWorld(const Vec3& direction, const Vec3& normal) {
     return res;
 }
 
-Vec3 Random::randomHemisphereDirection(const Vec3 &normal) {
+Vec3 Random::randomHemisphereDirection(const Vec3 &normal, Sampler &sampler) {
     /* 
         Uniformly generate a direction on the hemisphere oriented towards the positive y axis,
             represented by sphere coordinates
     */
-    float p = Random::randUniformFloat(); // Random float between 0 and 1
-    float q = Random::randUniformFloat(); // Random float between 0 and 1
+    auto [p, q] = sampler.get2D(); // Random floats between 0 and 1
     
     float azimuth = 2.0f * PI * p;    // [0, 2π]
     float elevation = acos(q);        // [0, π/2]
@@ -157,13 +157,12 @@ Vec3 Random::randomHemisphereDirection(const Vec3 &normal) {
     return localDirToWorld({x,y,z},normal);
 }
 
-Vec3 Random::cosWeightedHemisphere(const Vec3 &normal) {
+Vec3 Random::cosWeightedHemisphere(const Vec3 &normal, Sampler &sampler) {
     /* 
         Generate a direction on the hemisphere oriented towards the positive y axis, 
             cosine-weighted by the elevation angle.
     */
-    float p = Random::randUniformFloat();
-    float q = Random::randUniformFloat();
+    auto [p, q] = sampler.get2D();
     float azimuth = 2.0f * PI * p;
     float elevation = acos(sqrt(q));
 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Sampler.h"
+
+#include <cmath>
 #include <iostream>
-#include <random>
 
 constexpr float PI = 3.14159265f;
 
@@ -26,21 +28,27 @@ public:
     Vec3 operator/(float f) const;
     void operator+=(const Vec3& v);
 
+    /**
+     * @brief component by axis index: 0 for x, 1 for y, 2 for z
+    */
+    float operator[](int axis) const;
+
     float dot(const Vec3& v) const;
     Vec3 cross(const Vec3& v) const;
 
     float getLength() const;
     void normalize();
+    /**
+     * @brief perceived brightness of an RGB color, with the Rec. 709 weights
+    */
+    float luminance() const;
 };
 
+// Random directions, drawing their numbers from the sampler of the current sample
 class Random {
-    static std::mt19937 generator;
-    static std::uniform_real_distribution<float> distribution;
 public:
-    // Generate a random float in [0, 1)
-    static float randUniformFloat();
-    static Vec3 randomHemisphereDirection(const Vec3& normal);
-    static Vec3 cosWeightedHemisphere(const Vec3& normal);
+    static Vec3 randomHemisphereDirection(const Vec3& normal, Sampler& sampler);
+    static Vec3 cosWeightedHemisphere(const Vec3& normal, Sampler& sampler);
 };
 
 std::ostream& operator<<(std::ostream& os, const Vec3& v);
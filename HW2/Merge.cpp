@@ -0,0 +1,106 @@
+// Puts partial renders of a frame back together: RayTracingMerge OUTPUT PARTIAL...
+// The partials are the films written by RayTracing --partial, with the configuration of this build, all of the same
+// size, and no two of them may hold the same sample of a pixel. The output is the image of the frame, or another
+// partial film when it ends in .bin, which needs the samples of every pixel to follow on from each other
+
+#include "Config.h"
+#include "Film.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// the samples [begin, end) of a pixel that one of the partials holds
+struct SampleRange {
+    uint32_t begin, end;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " OUTPUT PARTIAL...\n";
+        return 1;
+    }
+
+    // all the headers first, so that nothing is allocated for partials that don't fit together
+    int width = 0, height = 0;
+    uint32_t firstSample = std::numeric_limits<uint32_t>::max();
+    for (int i = 2; i < argc; i++) {
+        int partialWidth, partialHeight;
+        uint32_t partialFirstSample;
+        if (!Film::readCheckpointInfo(argv[i], partialWidth, partialHeight, partialFirstSample)) return 1;
+        if (i == 2) {
+            width = partialWidth;
+            height = partialHeight;
+        } else if (partialWidth != width || partialHeight != height) {
+            std::cerr << "Partial film " << argv[i] << " is " << partialWidth << "x" << partialHeight << ", not "
+                      << width << "x" << height << " like " << argv[2] << ".\n";
+            return 1;
+        }
+        firstSample = std::min(firstSample, partialFirstSample);
+    }
+
+    Film film(width, height, firstSample);
+    // the samples of every pixel merged so far
+    std::vector<std::vector<SampleRange>> merged(static_cast<size_t>(width) * height);
+    for (int i = 2; i < argc; i++) {
+        Film partial(width, height);
+        if (!partial.load(argv[i])) return 1;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint32_t count = partial.getSampleCount(x, y);
+                if (count == 0) continue;
+                SampleRange range{partial.getFirstSample(), partial.getFirstSample() + count};
+                std::vector<SampleRange>& ranges = merged[static_cast<size_t>(y) * width + x];
+                for (const SampleRange& other : ranges) {
+                    if (range.begin < other.end && other.begin < range.end) {
+                        std::cerr << "Partial film " << argv[i] << " holds samples " << range.begin << " to "
+                                  << range.end << " of pixel (" << x << ", " << y << "), which overlap samples "
+                                  << other.begin << " to " << other.end << " of an earlier one.\n";
+                        return 1;
+                    }
+                }
+                ranges.push_back(range);
+            }
+        }
+        film.merge(partial);
+    }
+
+    std::filesystem::path outPath = std::filesystem::absolute(argv[1]);
+    if (outPath.extension() == ".bin") {
+        // a film holds the samples of every pixel from its first sample on, with no gaps
+        for (size_t pixel = 0; pixel < merged.size(); pixel++) {
+            std::vector<SampleRange>& ranges = merged[pixel];
+            std::sort(ranges.begin(), ranges.end(), [](const SampleRange& r1, const SampleRange& r2) {
+                return r1.begin < r2.begin;
+            });
+            uint32_t next = firstSample;
+            for (const SampleRange& range : ranges) {
+                if (range.begin != next) {
+                    std::cerr << "The samples of pixel (" << pixel % width << ", " << pixel / width
+                              << ") don't all follow on from sample " << firstSample
+                              << ", so the partials can only be merged into an image.\n";
+                    return 1;
+                }
+                next = range.end;
+            }
+        }
+        if (!film.save(outPath)) {
+            std::cerr << "Film " << outPath << " can't be written.\n";
+            return 1;
+        }
+        std::cout << "Merged film written to " << outPath << '\n';
+        return 0;
+    }
+    if (!writePPM(outPath, width, height, developImage(film, THREAD_COUNT))) {
+        std::cerr << "Output image " << outPath << " can't be written.\n";
+        return 1;
+    }
+    std::cout << "Output image written to " << outPath << '\n';
+}
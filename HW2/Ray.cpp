@@ -1,6 +1,12 @@
 #include "Ray.h"
 
-Ray::Ray(const Vec3 &p, const Vec3 &d) : pos(p), dir(d) {
+Ray::Ray(const Vec3 &p, const Vec3 &d, float tMin, float tMax)
+    : pos(p), dir(d),
+      // a zero component gives an infinite inverse, which the slab tests handle
+      invDir(1.0f / d.x, 1.0f / d.y, 1.0f / d.z),
+      // from the inverse, so that a -0.0 component, whose inverse is -inf, enters through the max plane too
+      dirIsNeg{invDir.x < 0, invDir.y < 0, invDir.z < 0},
+      tMin(tMin), tMax(tMax) {
 }
 
 Vec3 Ray::travel(float time) const {
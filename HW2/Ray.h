@@ -1,15 +1,23 @@
 #pragma once
 
 #include "Math.h"
+#include <limits>
 
 class Ray {
 public:
+    // set through the constructor, which caches what the slab tests need from them
     Vec3 pos;
     Vec3 dir;
+    Vec3 invDir;
+    // whether dir points towards -x, -y, -z: the ray enters a box through its max plane on those axes
+    bool dirIsNeg[3] = {false, false, false};
+    // only hits within [tMin, tMax] are searched for; queries shrink tMax as they find closer hits
+    float tMin = 0.0f;
+    float tMax = std::numeric_limits<float>::max();
 
     Ray() = default;
-    Ray(const Vec3& p, const Vec3& d);
+    Ray(const Vec3& p, const Vec3& d, float tMin = 0.0f, float tMax = std::numeric_limits<float>::max());
 
     Vec3 travel(float time) const;
     bool isNormalized() const;
-};
\ No newline at end of file
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "Config.h"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// The dimensions of a sample, in the order they are drawn: the camera takes the first ones, and every bounce of the
+// path the same number after them, so a dimension always feeds the same decision whatever the earlier bounces drew.
+// 2D numbers start on an even dimension; a 1D number leaves the odd one after it unused
+// camera: pixel position (2), lens position (2)
+constexpr uint32_t CAMERA_DIMENSIONS = 4;
+// bounce: light choice (1 + 1), light position (2), BSDF direction (2), Russian roulette (1 + 1). Sampling the light
+// may stop before it draws the position, so the BSDF starts again from its own offset in the bounce
+constexpr uint32_t BOUNCE_DIMENSIONS = 8;
+constexpr uint32_t BOUNCE_BSDF_DIMENSION = 4;
+
+/**
+ * @brief the PCG hash: one LCG step followed by the RXS-M-XS output permutation of PCG
+*/
+inline uint32_t hashPCG(uint32_t value) {
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+/**
+ * @brief a uniform float in [0, 1) from 32 random bits; the top 24 fill the mantissa exactly
+*/
+inline float bitsToFloat(uint32_t bits) {
+    return static_cast<float>(bits >> 8) * 0x1p-24f;
+}
+
+/**
+ * @brief independent random numbers: every number is a hash of (pixel, sample index, dimension)
+*/
+struct IndependentSequence {
+    static float get1D(uint32_t seed, uint32_t pixel, uint32_t sampleIndex, uint32_t dimension) {
+        return bitsToFloat(hashPCG(pixel ^ hashPCG(sampleIndex ^ hashPCG(dimension ^ hashPCG(seed)))));
+    }
+    static std::pair<float, float> get2D(uint32_t seed, uint32_t pixel, uint32_t sampleIndex, uint32_t dimension) {
+        return {get1D(seed, pixel, sampleIndex, dimension), get1D(seed, pixel, sampleIndex, dimension + 1)};
+    }
+};
+
+/**
+ * @brief the columns of the generator matrix of the second Sobol dimension, bits reversed, summed over every value of
+ * each byte of an index
+*/
+constexpr std::array<std::array<uint32_t, 256>, 4> makeSobolSecondTables() {
+    std::array<std::array<uint32_t, 256>, 4> tables{};
+    uint32_t columns[32] = {};
+    columns[0] = 1;
+    for (int bit = 1; bit < 32; bit++) {
+        columns[bit] = columns[bit - 1] ^ columns[bit - 1] << 1;
+    }
+    for (int byte = 0; byte < 4; byte++) {
+        for (uint32_t value = 0; value < 256; value++) {
+            uint32_t result = 0;
+            for (int bit = 0; bit < 8; bit++) {
+                if (value >> bit & 1) result ^= columns[8 * byte + bit];
+            }
+            tables[byte][value] = result;
+        }
+    }
+    return tables;
+}
+
+inline constexpr std::array<std::array<uint32_t, 256>, 4> SOBOL_SECOND_TABLES = makeSobolSecondTables();
+
+/**
+ * @brief the first two dimensions of the Sobol sequence, Owen scrambled, for every pair of dimensions
+ * the samples of a pixel are spread evenly over the unit square in every pair: any 2^k of them in a row from an
+ * aligned start put one point in each of the 2^k equal dyadic rectangles of any shape. Each pair and each pixel shuffles
+ * the order of the samples and scrambles their digits with its own seed, so the pairs and the pixels don't correlate
+ * (Burley 2020, Practical Hash-based Owen Scrambling)
+*/
+struct SobolSequence {
+    static float get1D(uint32_t seed, uint32_t pixel, uint32_t sampleIndex, uint32_t dimension) {
+        uint32_t pairSeed = hashPCG(pixel ^ hashPCG(dimension / 2 ^ hashPCG(seed)));
+        uint32_t index = shuffle(sampleIndex, pairSeed);
+        uint32_t reversed = dimension & 1 ? sobolSecondReversed(index) : index;
+        return bitsToFloat(reverseBits(laineKarras(reversed, hashPCG(pairSeed + (dimension & 1)))));
+    }
+    static std::pair<float, float> get2D(uint32_t seed, uint32_t pixel, uint32_t sampleIndex, uint32_t dimension) {
+        uint32_t pairSeed = hashPCG(pixel ^ hashPCG(dimension / 2 ^ hashPCG(seed)));
+        uint32_t index = shuffle(sampleIndex, pairSeed);
+        uint32_t x = reverseBits(laineKarras(index, hashPCG(pairSeed)));
+        uint32_t y = reverseBits(laineKarras(sobolSecondReversed(index), hashPCG(pairSeed + 1)));
+        return {bitsToFloat(x), bitsToFloat(y)};
+    }
+
+private:
+    static uint32_t reverseBits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    /**
+     * @brief a hash that flips every bit depending only on the bits below it (Laine and Karras 2011, as tuned by
+     * Burley). On the reversed digits of a fraction it is an Owen scrambling: every digit flipped or not by the
+     * digits above it
+    */
+    static uint32_t laineKarras(uint32_t x, uint32_t seed) {
+        x ^= x * 0x3d20adeau;
+        x += seed;
+        x *= (seed >> 16) | 1;
+        x ^= x * 0x05526c56u;
+        x ^= x * 0x53a22864u;
+        return x;
+    }
+
+    /**
+     * @brief reorder the sample indices by Owen scrambling their bits; any aligned run of 2^k indices maps onto another
+    */
+    static uint32_t shuffle(uint32_t index, uint32_t seed) {
+        return reverseBits(laineKarras(reverseBits(index), seed));
+    }
+
+    /**
+     * @brief the second dimension of the Sobol sequence, with the bits of the fraction reversed. The first dimension
+     * is the index itself reversed
+     * its generator matrix is the upper triangular Pascal matrix mod 2, whose columns each follow from the last; the
+     * shuffled indices use all 32 bits, so the product is looked up a byte of the index at a time
+    */
+    static uint32_t sobolSecondReversed(uint32_t index) {
+        return SOBOL_SECOND_TABLES[0][index & 0xff] ^ SOBOL_SECOND_TABLES[1][index >> 8 & 0xff] ^
+               SOBOL_SECOND_TABLES[2][index >> 16 & 0xff] ^ SOBOL_SECOND_TABLES[3][index >> 24];
+    }
+};
+
+/**
+ * @brief numbers for the samples of a pixel, drawn from a Sequence
+ * every number only depends on (pixel, sample index, dimension), so any sample can be drawn on its own, on any thread,
+ * and gives the same values every time. A Sequence provides
+ *   static float get1D(uint32_t seed, uint32_t pixel, uint32_t sampleIndex, uint32_t dimension);
+ *   static std::pair<float, float> get2D(uint32_t seed, uint32_t pixel, uint32_t sampleIndex, uint32_t dimension);
+ * with uniform numbers in [0, 1), the 2D ones from an even dimension
+*/
+template<typename Sequence>
+class BasicSampler {
+public:
+    /**
+     * @param seed: varies the numbers of all the pixels at once
+    */
+    explicit BasicSampler(uint32_t seed) : seed(seed) {}
+
+    /**
+     * @brief start the numbers of one sample of one pixel, from the camera dimensions
+    */
+    void startSample(uint32_t pixel, uint32_t sampleIndex) {
+        this->pixel = pixel;
+        this->sampleIndex = sampleIndex;
+        dimension = 0;
+    }
+
+    /**
+     * @brief move on to the dimensions of a bounce of the path, 0 for the first hit, from `offset` within the bounce
+    */
+    void startBounce(int depth, uint32_t offset = 0) {
+        dimension = CAMERA_DIMENSIONS + static_cast<uint32_t>(depth) * BOUNCE_DIMENSIONS + offset;
+    }
+
+    /**
+     * @brief a uniform float in [0, 1) for the next dimension
+    */
+    float get1D() {
+        return Sequence::get1D(seed, pixel, sampleIndex, dimension++);
+    }
+
+    /**
+     * @brief a uniform point of the unit square for the next two dimensions, from an even one
+    */
+    std::pair<float, float> get2D() {
+        dimension += dimension & 1;
+        auto result = Sequence::get2D(seed, pixel, sampleIndex, dimension);
+        dimension += 2;
+        return result;
+    }
+
+private:
+    uint32_t seed;
+    uint32_t pixel = 0;
+    uint32_t sampleIndex = 0;
+    uint32_t dimension = 0;
+};
+
+using Sampler = BasicSampler<std::conditional_t<SAMPLER == SamplerType::Sobol, SobolSequence, IndependentSequence>>;
@@ -1,6 +1,7 @@
 #include "Scene.h"
 #include "Config.h"
 #include <iostream>
+#include <algorithm>
 #include <filesystem>
 
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -86,57 +87,84 @@ Vec3 Scene::trace(const Ray &ray, int bouncesLeft, bool discardEmission) {
 */
 
 //Task 8
-Vec3 Scene::trace(const Ray &ray, int bouncesLeft, bool discardEmission) {
-    if constexpr(DEBUG) {
-        assert (ray.isNormalized());
-    }
-    if (bouncesLeft < 0) return {};
-    Intersection inter = getIntersection(ray);
-
-    if (!inter.happened) return {};
-
-    Vec3 Lo(0.0f, 0.0f, 0.0f);
-    if (!discardEmission) {
-        Lo += inter.getEmission();
-    }
-
-    Vec3 indirectRadiance(0.0f, 0.0f, 0.0f);
-
-    Vec3 randomDir = Random::cosWeightedHemisphere(inter.getNormal());  
-    Ray randomRay(inter.pos, randomDir);
-    Intersection bounceInter = getIntersection(randomRay);
-
-    if (bounceInter.happened) {
-        Vec3 Li = trace(randomRay, bouncesLeft - 1, true);
-        Vec3 brdf = inter.calcBRDF(-randomDir, -ray.dir);
-        float cosineTerm = randomDir.dot(inter.getNormal());
-        float pdf = cosineTerm / PI;
-        indirectRadiance = (Li * brdf * cosineTerm) / pdf;
-    }
-
-    Vec3 directRadiance(0.0f, 0.0f, 0.0f);
-
-    Intersection lightSample = sampleLight();
+ShadowRay Scene::sampleShadowRay(const Intersection &inter, const Vec3 &outDir, Sampler &sampler) const {
+    auto [lightSample, pdfLightSample] = sampleLight(inter, sampler);
+    if (pdfLightSample <= 0) return {};
     Vec3 lightDir = lightSample.pos - inter.pos;
     float distanceToLight = lightDir.getLength();
     lightDir.normalize();
 
-    Ray rayToLight = {inter.pos, lightDir};
-    Intersection lightInter = getIntersection(rayToLight);
+    // the light only emits from its front face
+    float lightCosineTerm = -lightDir.dot(lightSample.getNormal());
+    if (lightCosineTerm <= 0) return {};
 
-    if (lightInter.happened && (lightInter.object == lightSample.object)) {
+    Vec3 brdf = inter.calcBRDF(-lightDir, outDir);
+    float cosineTerm = lightDir.dot(inter.getNormal());
 
-        Vec3 brdf = inter.calcBRDF(-lightDir, -ray.dir);
-        float cosineTerm = lightDir.dot(inter.getNormal());
-        float lightCosineTerm = -lightDir.dot(lightSample.getNormal());
+    float attenuation = 1.0f / (distanceToLight * distanceToLight);
 
-        float pdfLightSample = 1.0f / lightArea;
-        float attenuation = 1.0f / (distanceToLight * distanceToLight);
+    ShadowRay result;
+    result.valid = true;
+    result.origin = inter.pos;
+    result.target = lightSample.pos;
+    result.radiance = (lightSample.getEmission() * brdf * cosineTerm * lightCosineTerm * attenuation) / pdfLightSample;
+    return result;
+}
 
-        directRadiance = (lightSample.getEmission() * brdf * cosineTerm * lightCosineTerm * attenuation) / pdfLightSample;
+Vec3 Scene::sampleDirect(const Intersection &inter, const Vec3 &outDir, Sampler &sampler) const {
+    ShadowRay shadow = sampleShadowRay(inter, outDir, sampler);
+    if (!shadow.valid || occluded(shadow.origin, shadow.target)) return {};
+    return shadow.radiance;
+}
+
+bool Scene::sampleBounce(const Intersection &inter, const Vec3 &outDir, int depth, Sampler &sampler,
+                         Vec3 &throughput, Vec3 &bounceDir) const {
+    sampler.startBounce(depth, BOUNCE_BSDF_DIMENSION);
+    bounceDir = Random::cosWeightedHemisphere(inter.getNormal(), sampler);
+    Vec3 brdf = inter.calcBRDF(-bounceDir, outDir);
+    float cosineTerm = bounceDir.dot(inter.getNormal());
+    if (cosineTerm <= 0) return false;
+    float pdf = cosineTerm / PI;
+    throughput = throughput * brdf * cosineTerm / pdf;
+
+    // Russian roulette: paths carrying little light are ended early, the survivors weighted up to make up for it
+    float luminance = throughput.luminance();
+    if (luminance <= 0) return false;
+    if (depth + 1 >= RR_START_DEPTH) {
+        float survival = std::min(RR, luminance);
+        if (sampler.get1D() >= survival) return false;
+        throughput = throughput / survival;
     }
+    return true;
+}
 
-    Lo += indirectRadiance + directRadiance;
+Vec3 Scene::trace(const Ray &cameraRay, Sampler &sampler, AOVs *aovs) {
+    if constexpr(DEBUG) {
+        assert (cameraRay.isNormalized());
+    }
+    Ray ray = cameraRay;
+    Intersection inter = getIntersection(ray);
+    if (aovs) {
+        *aovs = inter.happened ? AOVs{inter.getDiffuseColor(), inter.getNormal(), inter.time} : AOVs{};
+    }
+    if (!inter.happened) return {};
+
+    // emission seen directly; after a bounce it is counted by the light sampling instead
+    Vec3 Lo = inter.getEmission();
+    // the fraction of the radiance at the current vertex that reaches the camera
+    Vec3 throughput(1.0f, 1.0f, 1.0f);
+
+    for (int depth = 0; ; depth++) {
+        sampler.startBounce(depth);
+        Lo += throughput * sampleDirect(inter, -ray.dir, sampler);
+        if (depth == maxDepth) break;
+
+        Vec3 bounceDir;
+        if (!sampleBounce(inter, -ray.dir, depth, sampler, throughput, bounceDir)) break;
+        ray = Ray(inter.pos, bounceDir);
+        inter = getIntersection(ray);
+        if (!inter.happened) break;
+    }
 
     return Lo;
 }
@@ -202,7 +230,6 @@ void Scene::addObjects(std::string_view modelPath, std::string_view searchPath)
             };
             object->hasEmission = true;
             lights.push_back(object);
-            lightArea += object->area;
         }
         objects.push_back(object);
     } // per-shape
@@ -210,19 +237,26 @@ void Scene::addObjects(std::string_view modelPath, std::string_view searchPath)
 
 void Scene::constructBVH() {
     assert (!objects.empty());
-    bvh.root = BVH::build(objects);
+    bvh.build(objects);
+    lightSampler.build(lights);
 }
 
 Intersection Scene::getIntersection(const Ray &ray) {
-    assert (bvh.root);
-    return bvh.root->intersect(ray);
+    assert (!bvh.nodes.empty());
+    return bvh.intersect(ray);
+}
+
+bool Scene::occluded(const Vec3 &origin, const Vec3 &target) const {
+    assert (!bvh.nodes.empty());
+    Vec3 dir = target - origin;
+    float distance = dir.getLength();
+    dir.normalize();
+    return bvh.occluded({origin, dir, MIN_TRAVEL_TIME, distance - MIN_TRAVEL_TIME});
 }
 
-Intersection Scene::sampleLight() const {
-    assert (lights.size() == 1 && "Currently only support a single light object");
-    assert (lightArea > 0.0f);
-    Intersection inter;
-    return lights[0]->sample();
+LightSample Scene::sampleLight(const Intersection &inter, Sampler &sampler) const {
+    assert (!lightSampler.empty());
+    return lightSampler.sample(inter.pos, inter.getNormal(), sampler);
 }
 
 Scene::~Scene() {
@@ -2,27 +2,69 @@
 
 #include "tiny_obj_loader.h"
 #include "Accel.h"
+#include "Film.h"
+#include "LightSampler.h"
 
 #include <string>
 #include <vector>
 
+/**
+ * @brief a light sample seen from a path vertex: the radiance it reflects there, unless the segment from `origin` to
+ * `target` is blocked
+ * not valid when the light can't reach the vertex anyway, and there is nothing to test
+*/
+struct ShadowRay {
+    bool valid = false;
+    Vec3 origin;
+    Vec3 target;
+    Vec3 radiance;
+};
+
 class Scene {
 public:
     static tinyobj::ObjReader reader;
     std::vector<Object*> objects;
     std::vector<Object*> lights;
     BVH bvh;
-
-    float lightArea = 0;
+    LightSampler lightSampler;
+    // bounces a path may take
+    int maxDepth = MAX_DEPTH;
 
     void addObjects(std::string_view modelPath, std::string_view searchPath);
+    /**
+     * @brief build the BVH over the triangles of all objects, and the light sampler over the emissive ones
+    */
     void constructBVH();
     Intersection getIntersection(const Ray& ray);
     /**
-     * @brief sample a point from the first object in the light vector
-     * @todo add support for multiple light objects
+     * @brief whether anything blocks the segment between two surface points
+     * the points themselves are excluded, so the surfaces they lie on never block it
+    */
+    bool occluded(const Vec3& origin, const Vec3& target) const;
+    /**
+     * @brief sample a point on any light, to light the surface point of `inter`
+    */
+    LightSample sampleLight(const Intersection& inter, Sampler& sampler) const;
+    /**
+     * @brief radiance along a camera ray, following its path iteratively for up to maxDepth bounces
+     * paths are cut by Russian roulette from RR_START_DEPTH bounces on
+     * @param aovs: if not null, receives the features of the first hit
+    */
+    Vec3 trace(const Ray& cameraRay, Sampler& sampler, AOVs* aovs = nullptr);
+    /**
+     * @brief radiance reflected towards outDir at a path vertex by a sample of the light
+    */
+    Vec3 sampleDirect(const Intersection& inter, const Vec3& outDir, Sampler& sampler) const;
+    /**
+     * @brief sampleDirect without the occlusion test, which is left to the caller
+    */
+    ShadowRay sampleShadowRay(const Intersection& inter, const Vec3& outDir, Sampler& sampler) const;
+    /**
+     * @brief sample the direction a path continues in from the vertex of `inter`, and weigh its throughput for it
+     * paths are cut by Russian roulette from RR_START_DEPTH bounces on
+     * @return false if the path ends here
     */
-    Intersection sampleLight() const;
-    Vec3 trace(const Ray& ray, int bouncesLeft = 2, bool discardEmission = false);
+    bool sampleBounce(const Intersection& inter, const Vec3& outDir, int depth, Sampler& sampler,
+                      Vec3& throughput, Vec3& bounceDir) const;
     ~Scene();
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How often the monitor thread reports progress
+constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(200);
+
+namespace {
+
+/**
+ * @brief the tiles waiting for one worker
+ * the owner takes them from the front, thieves from the back, so the owner keeps its run of neighbouring tiles
+*/
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<int> tiles;
+
+    bool popFront(int& tile) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tiles.empty()) return false;
+        tile = tiles.front();
+        tiles.pop_front();
+        return true;
+    }
+
+    bool popBack(int& tile) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tiles.empty()) return false;
+        tile = tiles.back();
+        tiles.pop_back();
+        return true;
+    }
+};
+
+} // namespace
+
+int getTileCount(int width, int height, int tileSize) {
+    return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+}
+
+Tile getTile(int width, int height, int tileSize, int index) {
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int x0 = index % tilesX * tileSize, y0 = index / tilesX * tileSize;
+    return Tile{index, x0, y0, std::min(x0 + tileSize, width), std::min(y0 + tileSize, height)};
+}
+
+void renderTiles(int width, int height, int tileSize, int threadCount,
+                 const std::function<void(const Tile&)>& renderTile,
+                 const std::function<void(float)>& onProgress) {
+    int tileCount = getTileCount(width, height, tileSize);
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threadCount = std::min(threadCount, std::max(tileCount, 1));
+
+    std::vector<WorkQueue> queues(threadCount);
+    for (int w = 0; w < threadCount; w++) {
+        for (int t = tileCount * w / threadCount; t < tileCount * (w + 1) / threadCount; t++) {
+            queues[w].tiles.push_back(t);
+        }
+    }
+
+    std::atomic<int> tilesDone{0};
+    auto work = [&](int self) {
+        int tile;
+        while (true) {
+            bool found = queues[self].popFront(tile);
+            // every queue only shrinks, so one empty pass over the others means the work is all taken
+            for (int i = 1; i < threadCount && !found; i++) {
+                found = queues[(self + i) % threadCount].popBack(tile);
+            }
+            if (!found) return;
+            renderTile(getTile(width, height, tileSize, tile));
+            tilesDone.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    std::mutex monitorMutex;
+    std::condition_variable monitorWake;
+    bool finished = false;
+    std::thread monitor;
+    if (onProgress) {
+        monitor = std::thread([&]() {
+            std::unique_lock<std::mutex> lock(monitorMutex);
+            while (!monitorWake.wait_for(lock, PROGRESS_INTERVAL, [&]() { return finished; })) {
+                onProgress(static_cast<float>(tilesDone.load(std::memory_order_relaxed)) / std::max(tileCount, 1));
+            }
+            onProgress(1.0f);
+        });
+    }
+
+    std::vector<std::thread> workers;
+    for (int w = 1; w < threadCount; w++) {
+        workers.emplace_back(work, w);
+    }
+    work(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(monitorMutex);
+        finished = true;
+    }
+    monitorWake.notify_one();
+    if (monitor.joinable()) monitor.join();
+}
+
+void parallelFor(int count, int chunkSize, int threadCount, const std::function<void(int begin, int end)>& body) {
+    if (count <= 0) return;
+    // a single row of tiles, one chunk wide each
+    renderTiles(count, 1, chunkSize, threadCount, [&](const Tile& tile) { body(tile.x0, tile.x1); }, {});
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <functional>
+
+/**
+ * @brief a rectangle of pixels [x0, x1) x [y0, y1), rendered as one task
+*/
+struct Tile {
+    int index;
+    int x0, y0;
+    int x1, y1;
+};
+
+/**
+ * @brief the number of tiles renderTiles splits the image into
+*/
+int getTileCount(int width, int height, int tileSize);
+/**
+ * @brief the tile of renderTiles with that index; the tiles are counted row by row
+*/
+Tile getTile(int width, int height, int tileSize, int index);
+
+/**
+ * @brief split the image into tiles and render them on a pool of threads
+ * every worker starts with a contiguous run of tiles and steals from the others once it runs out,
+ * so slow regions of the image don't leave threads idle
+ * @param tileSize: width and height of the tiles; the last row and column may be smaller
+ * @param threadCount: number of workers, 0 for one per hardware thread
+ * @param renderTile: called once for every tile, from any worker; it must only write the pixels of its tile
+ * @param onProgress: called from a separate monitor thread with the fraction of tiles done, up to 1; may be empty
+*/
+void renderTiles(int width, int height, int tileSize, int threadCount,
+                 const std::function<void(const Tile&)>& renderTile,
+                 const std::function<void(float)>& onProgress);
+
+/**
+ * @brief run `body` over the ranges [begin, end) that split [0, count) into chunks, on the pool of renderTiles
+*/
+void parallelFor(int count, int chunkSize, int threadCount, const std::function<void(int begin, int end)>& body);
@@ -0,0 +1,127 @@
+#pragma once
+
+// Fixed-width float vectors for the BVH, triangle and image kernels.
+// Widths 8 and 4 map to AVX and SSE registers when the compiler targets them, any other width to plain arrays,
+// so the kernels are written once and run everywhere.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// The widest vector the target has registers for
+#if defined(__AVX__)
+constexpr int SIMD_WIDTH = 8;
+#else
+constexpr int SIMD_WIDTH = 4;
+#endif
+
+/**
+ * @brief W floats processed together
+ * `min` and `max` return their second operand when either one is a NaN, as the SSE instructions do
+*/
+template<int W>
+struct SimdFloat {
+    float lanes[W];
+
+    static SimdFloat broadcast(float f) {
+        SimdFloat r;
+        for (int i = 0; i < W; i++) r.lanes[i] = f;
+        return r;
+    }
+    static SimdFloat load(const float* p) {
+        SimdFloat r;
+        for (int i = 0; i < W; i++) r.lanes[i] = p[i];
+        return r;
+    }
+    static SimdFloat loadUnaligned(const float* p) {
+        return load(p);
+    }
+    void store(float* p) const {
+        for (int i = 0; i < W; i++) p[i] = lanes[i];
+    }
+
+    template<typename Op>
+    friend SimdFloat apply(const SimdFloat& a, const SimdFloat& b, Op op) {
+        SimdFloat r;
+        for (int i = 0; i < W; i++) r.lanes[i] = op(a.lanes[i], b.lanes[i]);
+        return r;
+    }
+    friend SimdFloat operator+(const SimdFloat& a, const SimdFloat& b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+    friend SimdFloat operator-(const SimdFloat& a, const SimdFloat& b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+    friend SimdFloat operator*(const SimdFloat& a, const SimdFloat& b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+    friend SimdFloat operator/(const SimdFloat& a, const SimdFloat& b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+    friend SimdFloat min(const SimdFloat& a, const SimdFloat& b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    friend SimdFloat max(const SimdFloat& a, const SimdFloat& b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+    /**
+     * @brief comparisons return a bit mask, bit i for lane i; they are false for NaNs
+    */
+    template<typename Op>
+    friend int compare(const SimdFloat& a, const SimdFloat& b, Op op) {
+        int mask = 0;
+        for (int i = 0; i < W; i++) mask |= static_cast<int>(op(a.lanes[i], b.lanes[i])) << i;
+        return mask;
+    }
+    friend int operator<(const SimdFloat& a, const SimdFloat& b) { return compare(a, b, [](float x, float y) { return x < y; }); }
+    friend int operator<=(const SimdFloat& a, const SimdFloat& b) { return compare(a, b, [](float x, float y) { return x <= y; }); }
+    friend int operator>(const SimdFloat& a, const SimdFloat& b) { return compare(a, b, [](float x, float y) { return x > y; }); }
+    friend int operator>=(const SimdFloat& a, const SimdFloat& b) { return compare(a, b, [](float x, float y) { return x >= y; }); }
+    friend int operator!=(const SimdFloat& a, const SimdFloat& b) { return compare(a, b, [](float x, float y) { return x != y; }); }
+};
+
+#if defined(__AVX__)
+template<>
+struct SimdFloat<8> {
+    __m256 lanes;
+
+    static SimdFloat broadcast(float f) { return {_mm256_set1_ps(f)}; }
+    // `p` must be 32-byte aligned
+    static SimdFloat load(const float* p) { return {_mm256_load_ps(p)}; }
+    static SimdFloat loadUnaligned(const float* p) { return {_mm256_loadu_ps(p)}; }
+    void store(float* p) const { _mm256_storeu_ps(p, lanes); }
+
+    friend SimdFloat operator+(const SimdFloat& a, const SimdFloat& b) { return {_mm256_add_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat operator-(const SimdFloat& a, const SimdFloat& b) { return {_mm256_sub_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat operator*(const SimdFloat& a, const SimdFloat& b) { return {_mm256_mul_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat operator/(const SimdFloat& a, const SimdFloat& b) { return {_mm256_div_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat min(const SimdFloat& a, const SimdFloat& b) { return {_mm256_min_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat max(const SimdFloat& a, const SimdFloat& b) { return {_mm256_max_ps(a.lanes, b.lanes)}; }
+
+    friend int operator<(const SimdFloat& a, const SimdFloat& b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.lanes, b.lanes, _CMP_LT_OQ)); }
+    friend int operator<=(const SimdFloat& a, const SimdFloat& b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.lanes, b.lanes, _CMP_LE_OQ)); }
+    friend int operator>(const SimdFloat& a, const SimdFloat& b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.lanes, b.lanes, _CMP_GT_OQ)); }
+    friend int operator>=(const SimdFloat& a, const SimdFloat& b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.lanes, b.lanes, _CMP_GE_OQ)); }
+    friend int operator!=(const SimdFloat& a, const SimdFloat& b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.lanes, b.lanes, _CMP_NEQ_OQ)); }
+};
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+template<>
+struct SimdFloat<4> {
+    __m128 lanes;
+
+    static SimdFloat broadcast(float f) { return {_mm_set1_ps(f)}; }
+    // `p` must be 16-byte aligned
+    static SimdFloat load(const float* p) { return {_mm_load_ps(p)}; }
+    static SimdFloat loadUnaligned(const float* p) { return {_mm_loadu_ps(p)}; }
+    void store(float* p) const { _mm_storeu_ps(p, lanes); }
+
+    friend SimdFloat operator+(const SimdFloat& a, const SimdFloat& b) { return {_mm_add_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat operator-(const SimdFloat& a, const SimdFloat& b) { return {_mm_sub_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat operator*(const SimdFloat& a, const SimdFloat& b) { return {_mm_mul_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat operator/(const SimdFloat& a, const SimdFloat& b) { return {_mm_div_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat min(const SimdFloat& a, const SimdFloat& b) { return {_mm_min_ps(a.lanes, b.lanes)}; }
+    friend SimdFloat max(const SimdFloat& a, const SimdFloat& b) { return {_mm_max_ps(a.lanes, b.lanes)}; }
+
+    friend int operator<(const SimdFloat& a, const SimdFloat& b) { return _mm_movemask_ps(_mm_cmplt_ps(a.lanes, b.lanes)); }
+    friend int operator<=(const SimdFloat& a, const SimdFloat& b) { return _mm_movemask_ps(_mm_cmple_ps(a.lanes, b.lanes)); }
+    friend int operator>(const SimdFloat& a, const SimdFloat& b) { return _mm_movemask_ps(_mm_cmpgt_ps(a.lanes, b.lanes)); }
+    friend int operator>=(const SimdFloat& a, const SimdFloat& b) { return _mm_movemask_ps(_mm_cmpge_ps(a.lanes, b.lanes)); }
+    // _mm_cmpneq_ps is true for NaNs, unlike the other comparisons; the ordered form keeps them all alike
+    friend int operator!=(const SimdFloat& a, const SimdFloat& b) {
+        return _mm_movemask_ps(_mm_and_ps(_mm_cmpneq_ps(a.lanes, b.lanes), _mm_cmpord_ps(a.lanes, b.lanes)));
+    }
+};
+#endif
@@ -0,0 +1,250 @@
+#include "Wavefront.h"
+#include "Config.h"
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Paths handed to a worker at a time, in every stage
+constexpr int CHUNK_SIZE = 1024;
+
+/**
+ * @brief Vec3s stored as three planes
+*/
+struct Vec3Array {
+    std::vector<float> x, y, z;
+
+    void resize(size_t size) {
+        x.resize(size);
+        y.resize(size);
+        z.resize(size);
+    }
+    Vec3 get(size_t i) const {
+        return {x[i], y[i], z[i]};
+    }
+    void set(size_t i, const Vec3& v) {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+    void move(size_t from, size_t to) {
+        x[to] = x[from];
+        y[to] = y[from];
+        z[to] = z[from];
+    }
+};
+
+/**
+ * @brief the next rays of the paths still alive
+*/
+struct PathQueue {
+    Vec3Array origin, dir;
+    Vec3Array throughput;
+    std::vector<uint32_t> slot;  // index of the path in the batch
+    std::vector<uint8_t> keep;   // set by shading for the paths that bounce on
+    int size = 0;
+
+    void resize(size_t capacity) {
+        origin.resize(capacity);
+        dir.resize(capacity);
+        throughput.resize(capacity);
+        slot.resize(capacity);
+        keep.resize(capacity);
+    }
+    void move(int from, int to) {
+        origin.move(from, to);
+        dir.move(from, to);
+        throughput.move(from, to);
+        slot[to] = slot[from];
+    }
+};
+
+/**
+ * @brief the shadow rays of one bounce, with the radiance each one brings to its path if nothing blocks it
+*/
+struct ShadowQueue {
+    Vec3Array origin, target;
+    Vec3Array radiance;
+    std::vector<uint32_t> slot;
+    std::vector<uint8_t> keep;   // set by shading for the shadow rays that need testing
+    int size = 0;
+
+    void resize(size_t capacity) {
+        origin.resize(capacity);
+        target.resize(capacity);
+        radiance.resize(capacity);
+        slot.resize(capacity);
+        keep.resize(capacity);
+    }
+    void move(int from, int to) {
+        origin.move(from, to);
+        target.move(from, to);
+        radiance.move(from, to);
+        slot[to] = slot[from];
+    }
+};
+
+/**
+ * @brief move the entries to keep to the front of the queue, in order, and drop the rest
+*/
+template<typename Queue>
+void compact(Queue& queue) {
+    int count = 0;
+    for (int i = 0; i < queue.size; i++) {
+        if (!queue.keep[i]) continue;
+        if (count != i) queue.move(i, count);
+        count++;
+    }
+    queue.size = count;
+}
+
+/**
+ * @brief what a batch keeps for each of its paths until they are all done
+*/
+struct Batch {
+    std::vector<uint32_t> pixel;  // y * width + x
+    std::vector<float> filmX, filmY;
+    std::vector<Sampler> samplers;
+    Vec3Array radiance;
+    std::vector<AOVs> aovs;
+
+    explicit Batch(size_t capacity)
+        : pixel(capacity), filmX(capacity), filmY(capacity), samplers(capacity, Sampler(SEED)), aovs(capacity) {
+        radiance.resize(capacity);
+    }
+};
+
+} // namespace
+
+void renderWavefront(Scene& scene, Film& film, const Camera& camera, const std::vector<uint32_t>& pixels, int spp,
+                     int threadCount,
+                     const std::function<void(float)>& onProgress) {
+    int width = film.getWidth();
+    size_t capacity = std::min(static_cast<size_t>(WAVEFRONT_BATCH_SIZE), std::max(pixels.size(), size_t{1}));
+
+    Batch batch(capacity);
+    PathQueue paths;
+    ShadowQueue shadows;
+    paths.resize(capacity);
+    shadows.resize(capacity);
+    std::vector<Intersection> hits(capacity);
+
+    // the pixels still taking samples, one more each pass
+    std::vector<uint32_t> active = pixels;
+    uint32_t fewestSamples = spp;
+    for (uint32_t pixel : active) {
+        fewestSamples = std::min(fewestSamples, film.getSampleCount(pixel % width, pixel / width));
+    }
+    int passes = spp - static_cast<int>(fewestSamples);
+
+    for (int pass = 0; ; pass++) {
+        // the pixels are checked between batches of samples, and left alone once they have converged
+        active.erase(std::remove_if(active.begin(), active.end(), [&](uint32_t pixel) {
+            uint32_t samples = film.getSampleCount(pixel % width, pixel / width);
+            if (samples >= static_cast<uint32_t>(spp)) return true;
+            return ADAPTIVE_SAMPLING && samples % ADAPTIVE_BATCH == 0 &&
+                   film.isConverged(pixel % width, pixel / width, ADAPTIVE_MIN_SPP, ADAPTIVE_ERROR);
+        }), active.end());
+        if (active.empty()) break;
+
+        for (size_t first = 0; first < active.size(); first += capacity) {
+            int count = static_cast<int>(std::min(capacity, active.size() - first));
+
+            // generate camera rays
+            parallelFor(count, CHUNK_SIZE, threadCount, [&](int begin, int end) {
+                for (int p = begin; p < end; p++) {
+                    uint32_t pixel = active[first + p];
+                    batch.pixel[p] = pixel;
+                    uint32_t sampleIndex = film.getFirstSample() + film.getSampleCount(pixel % width, pixel / width);
+                    batch.samplers[p].startSample(pixel, sampleIndex);
+                    batch.radiance.set(p, {});
+                    batch.aovs[p] = {};
+                    CameraSample cameraSample = camera.sample(pixel % width, pixel / width, batch.samplers[p]);
+                    batch.filmX[p] = cameraSample.filmX;
+                    batch.filmY[p] = cameraSample.filmY;
+                    paths.origin.set(p, cameraSample.ray.pos);
+                    paths.dir.set(p, cameraSample.ray.dir);
+                    paths.throughput.set(p, {1.0f, 1.0f, 1.0f});
+                    paths.slot[p] = p;
+                }
+            });
+            paths.size = count;
+
+            for (int depth = 0; paths.size > 0; depth++) {
+                // extend: the closest hit of every ray
+                parallelFor(paths.size, CHUNK_SIZE, threadCount, [&](int begin, int end) {
+                    for (int k = begin; k < end; k++) {
+                        hits[k] = scene.getIntersection(Ray(paths.origin.get(k), paths.dir.get(k)));
+                    }
+                });
+
+                // shade: light the hits, and sample the bounces; the rays are rewritten in place
+                parallelFor(paths.size, CHUNK_SIZE, threadCount, [&](int begin, int end) {
+                    for (int k = begin; k < end; k++) {
+                        const Intersection& inter = hits[k];
+                        uint32_t slot = paths.slot[k];
+                        paths.keep[k] = false;
+                        shadows.keep[k] = false;
+                        if (!inter.happened) continue;
+
+                        Vec3 outDir = -paths.dir.get(k);
+                        Vec3 throughput = paths.throughput.get(k);
+                        Sampler& sampler = batch.samplers[slot];
+                        sampler.startBounce(depth);
+                        if (depth == 0) {
+                            // emission seen directly; after a bounce it is counted by the light sampling instead
+                            batch.radiance.set(slot, batch.radiance.get(slot) + inter.getEmission());
+                            batch.aovs[slot] = {inter.getDiffuseColor(), inter.getNormal(), inter.time};
+                        }
+
+                        ShadowRay shadow = scene.sampleShadowRay(inter, outDir, sampler);
+                        if (shadow.valid) {
+                            shadows.origin.set(k, shadow.origin);
+                            shadows.target.set(k, shadow.target);
+                            shadows.radiance.set(k, throughput * shadow.radiance);
+                            shadows.slot[k] = slot;
+                            shadows.keep[k] = true;
+                        }
+
+                        if (depth == scene.maxDepth) continue;
+                        Vec3 bounceDir;
+                        if (!scene.sampleBounce(inter, outDir, depth, sampler, throughput, bounceDir)) continue;
+                        paths.origin.set(k, inter.pos);
+                        paths.dir.set(k, bounceDir);
+                        paths.throughput.set(k, throughput);
+                        paths.keep[k] = true;
+                    }
+                });
+
+                // test the shadow rays that may bring light
+                shadows.size = paths.size;
+                compact(shadows);
+                parallelFor(shadows.size, CHUNK_SIZE, threadCount, [&](int begin, int end) {
+                    for (int k = begin; k < end; k++) {
+                        if (scene.occluded(shadows.origin.get(k), shadows.target.get(k))) continue;
+                        uint32_t slot = shadows.slot[k];
+                        batch.radiance.set(slot, batch.radiance.get(slot) + shadows.radiance.get(k));
+                    }
+                });
+
+                compact(paths);
+            }
+
+            // every pixel appears once in a batch, so the batch can be added in parallel; the pixels of a chunk are
+            // in order, and splat into a tile over their rows
+            parallelFor(count, CHUNK_SIZE, threadCount, [&](int begin, int end) {
+                FilmTile filmTile(film, 0, batch.pixel[begin] / width, width, batch.pixel[end - 1] / width + 1);
+                for (int p = begin; p < end; p++) {
+                    Vec3 radiance = batch.radiance.get(p);
+                    film.addSample(batch.pixel[p] % width, batch.pixel[p] / width, radiance, batch.aovs[p]);
+                    filmTile.addSample(batch.filmX[p], batch.filmY[p], radiance);
+                }
+                film.mergeTile(filmTile);
+            });
+        }
+        if (onProgress) onProgress(static_cast<float>(pass + 1) / passes);
+    }
+    if (onProgress) onProgress(1.0f);
+}
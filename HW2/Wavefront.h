@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Camera.h"
+#include "Film.h"
+#include "Scene.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief take samples into the pixels of the film with a wavefront path tracer, until each has `spp` of them or, with
+ * adaptive sampling, has converged; pixels carry on from the samples they already have
+ * instead of following one path to its end at a time, it keeps batches of up to WAVEFRONT_BATCH_SIZE paths in SoA
+ * queues and runs each stage over a whole batch before the next one: generate camera rays, extend them to their
+ * closest hits, shade the hits into shadow rays and bounce rays, then test the shadow rays. The queues are compacted
+ * between stages, so later bounces only work on the paths still alive
+ * the paths draw the same numbers as Scene::trace, so both render the same image
+ * @param pixels: y * width + x of the pixels to sample, in increasing order
+ * @param onProgress: as for renderTiles
+*/
+void renderWavefront(Scene& scene, Film& film, const Camera& camera, const std::vector<uint32_t>& pixels, int spp,
+                     int threadCount,
+                     const std::function<void(float)>& onProgress);
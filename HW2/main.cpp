@@ -1,16 +1,20 @@
 #include "Scene.h"
 #include "Config.h"
+#include "Camera.h"
+#include "Film.h"
+#include "Image.h"
+#include "Job.h"
+#include "Wavefront.h"
+#include "Scheduler.h"
 
 #include <filesystem>
 #include <fstream>
 #include <algorithm>
 #include <chrono>
 
-constexpr float GAMMA = 0.6f;
-
 void UpdateProgress(float progress)
 {
-    static bool checkPoints[10] = {false};
+    static bool checkPoints[11] = {false};
     if constexpr(DEBUG) {
         int barWidth = 32;
 
@@ -36,71 +40,156 @@ inline float toneMap(float x) {
     return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
 }
 
-unsigned char toLinear(float sRGB) {
-    return 255 * std::pow(std::clamp(sRGB, 0.0f, 1.0f), GAMMA);
-}
-
-int main() {
+int main(int argc, char* argv[]) {
     using namespace std::chrono;
     auto startTime = high_resolution_clock::now();
 
+    Job job;
+    if (!parseJob(argc, argv, job)) return 1;
+    std::filesystem::path checkpointPath = job.isPartial() ? job.partialPath : std::filesystem::path(CHECKPOINT_PATH);
+
     Scene scene;
-    scene.addObjects(OBJ_PATH, MTL_SEARCH_DIR);
+    scene.addObjects(job.scenePath, job.materialDir);
     scene.constructBVH();
+    scene.maxDepth = job.maxDepth;
     
     auto timeAfterVBVH = high_resolution_clock::now();
     std::cout << "BVH Construction time in seconds: " << duration_cast<seconds>(timeAfterVBVH - startTime).count() << '\n';
-    int width = RESOLUTION, height = RESOLUTION;
-    std::vector<std::vector<Vec3>> image(height, std::vector<Vec3>(width));
-    Vec3 cameraPos = {
-        0.0f, 1.0f, 4.0f
-    };
+    int width = job.resolution, height = job.resolution;
+    Film film(width, height, job.sampleBegin);
+    // x: right
+    // y: up
+    // z: outwards
+    Camera camera({0.0f, 1.0f, 4.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, CAMERA_FOV, width, height,
+                  CAMERA_APERTURE, CAMERA_FOCUS_DISTANCE);
 
     if constexpr(!DEBUG) {
         std::cout << "Debug mode disabled. Progress output will be in brief." <<  '\n';
     }
 
-    // x: right
-    // y: up
-    // z: outwards
-    for (size_t y = 0; y < height; y++) {
-        for (size_t x = 0; x < width; x++) {
-            Vec3 worldPos = {
-                (float)x / width - 0.5f, 
-                1.5f - (float)y / height,
-                (cameraPos.z + 1.0f) / 2
-            };
-            Ray ray {
-                cameraPos,
-                worldPos - cameraPos,
-            };
-            ray.dir.normalize();
-            Vec3 value {};
-            for (int i = 0; i < SPP; i++) {
-                value += scene.trace(ray, MAX_DEPTH);
+    if constexpr(RESUME) {
+        if (std::filesystem::exists(checkpointPath)) {
+            if (!film.load(checkpointPath)) exit(1);
+            if (film.getFirstSample() != static_cast<uint32_t>(job.sampleBegin)) {
+                std::cerr << "Checkpoint " << checkpointPath << " starts from sample " << film.getFirstSample() << ".\n";
+                exit(1);
+            }
+            std::cout << "Resuming from checkpoint " << std::filesystem::absolute(checkpointPath) << '\n';
+        }
+    }
+
+    // the pixels of the tiles in the range, row by row
+    int tileCount = getTileCount(width, height, TILE_SIZE);
+    std::vector<uint32_t> pixels;
+    for (int t = job.tileBegin; t < std::min(job.tileEnd, tileCount); t++) {
+        Tile tile = getTile(width, height, TILE_SIZE, t);
+        for (int y = tile.y0; y < tile.y1; y++) {
+            for (int x = tile.x0; x < tile.x1; x++) {
+                pixels.push_back(y * width + x);
             }
-            image[y][x] = value / SPP;
-            UpdateProgress((float)(y * width + x) / (width * height));
         }
     }
+    std::sort(pixels.begin(), pixels.end());
+
+    // every pixel takes samples up to the end of a round, then the film is saved before the next round starts.
+    // With a time budget, a first round of a single sample measures how long a round takes per sample, and the later
+    // rounds only take as many samples as the time left allows at the pace of the last one
+    int spp = job.sampleEnd - job.sampleBegin;
+    int roundSpp = CHECKPOINT_SPP > 0 ? CHECKPOINT_SPP : spp;
+    bool hasBudget = job.timeBudget > 0;
+    auto deadline = startTime + duration_cast<high_resolution_clock::duration>(duration<double>(job.timeBudget));
+    double secondsPerSample = 0.0;
+    uint32_t fewestSamples = spp;
+    for (uint32_t pixel : pixels) {
+        fewestSamples = std::min(fewestSamples, film.getSampleCount(pixel % width, pixel / width));
+    }
+    auto countSamples = [&]() {
+        uint64_t samples = 0;
+        for (uint32_t pixel : pixels) {
+            samples += film.getSampleCount(pixel % width, pixel / width);
+        }
+        return samples;
+    };
+    for (int roundStart = fewestSamples; roundStart < spp; ) {
+        int roundEnd = std::min(roundStart + roundSpp, spp);
+        if (hasBudget && secondsPerSample > 0.0) {
+            double secondsLeft = duration<double>(deadline - high_resolution_clock::now()).count();
+            // clamped before the conversion, which a long budget of fast samples would overflow
+            double affordable = std::min(std::max(secondsLeft, 0.0) / secondsPerSample,
+                                         static_cast<double>(roundEnd - roundStart));
+            if (affordable < 1.0) break;
+            roundEnd = roundStart + static_cast<int>(affordable);
+        } else if (hasBudget) {
+            // the image gets at least this round, however late
+            roundEnd = roundStart + 1;
+        }
+        auto onProgress = [&](float progress) {
+            if (hasBudget) {
+                double elapsed = duration<double>(high_resolution_clock::now() - startTime).count();
+                UpdateProgress(static_cast<float>(std::min(elapsed / job.timeBudget, 1.0)));
+            } else {
+                UpdateProgress((roundStart + progress * (roundEnd - roundStart)) / spp);
+            }
+        };
+        auto roundStartTime = high_resolution_clock::now();
+        uint64_t samplesBefore = countSamples();
+        if constexpr(WAVEFRONT) {
+            renderWavefront(scene, film, camera, pixels, roundEnd, job.threadCount, onProgress);
+        } else {
+            renderTiles(width, height, TILE_SIZE, job.threadCount, [&](const Tile& tile) {
+                if (tile.index < job.tileBegin || tile.index >= job.tileEnd) return;
+                Sampler sampler(SEED);
+                FilmTile filmTile(film, tile.x0, tile.y0, tile.x1, tile.y1);
+                for (int y = tile.y0; y < tile.y1; y++) {
+                    for (int x = tile.x0; x < tile.x1; x++) {
+                        for (int i = film.getSampleCount(x, y); i < roundEnd; i++) {
+                            // the pixel is checked between batches of samples, and left alone once it has converged
+                            if (ADAPTIVE_SAMPLING && i % ADAPTIVE_BATCH == 0 && film.isConverged(x, y, ADAPTIVE_MIN_SPP, ADAPTIVE_ERROR)) break;
+                            sampler.startSample(y * width + x, film.getFirstSample() + i);
+                            CameraSample cameraSample = camera.sample(x, y, sampler);
+                            AOVs aovs;
+                            Vec3 radiance = scene.trace(cameraSample.ray, sampler, &aovs);
+                            film.addSample(x, y, radiance, aovs);
+                            filmTile.addSample(cameraSample.filmX, cameraSample.filmY, radiance);
+                        }
+                    }
+                }
+                film.mergeTile(filmTile);
+            }, onProgress);
+        }
+        secondsPerSample = duration<double>(high_resolution_clock::now() - roundStartTime).count() / (roundEnd - roundStart);
+        if constexpr(CHECKPOINT_SPP > 0) {
+            if (!film.save(checkpointPath)) {
+                std::cerr << "Checkpoint " << std::filesystem::absolute(checkpointPath) << " can't be written.\n";
+            }
+        }
+        roundStart = roundEnd;
+        // with adaptive sampling every pixel may have converged long before spp, which a budget may not bound
+        if (countSamples() == samplesBefore) break;
+    }
+    UpdateProgress(1.0f);
     std::cout << std::endl;
 
     auto finishTime = high_resolution_clock::now();
     std::cout << "Rendering time in seconds: " << duration_cast<seconds>(finishTime - timeAfterVBVH).count() << '\n';
+    if (ADAPTIVE_SAMPLING || hasBudget) {
+        std::cout << "Average samples per pixel: " << static_cast<double>(countSamples()) / std::max(pixels.size(), size_t{1}) << '\n';
+    }
 
-    std::filesystem::path outPath = std::filesystem::absolute(OUTPUT_PATH);
-
-    FILE* fp = fopen(outPath.string().c_str(), "wb");
-    (void)fprintf(fp, "P6\n%d %d\n255\n", width, height);
-    for (size_t y = 0; y < height; y++) {
-        for (size_t x = 0; x < width; x++) {
-            static unsigned char color[3];
-            color[0] = toLinear(image[y][x].x);
-            color[1] = toLinear(image[y][x].y);
-            color[2] = toLinear(image[y][x].z);
-            fwrite(color, 1, 3, fp);
+    if (job.isPartial()) {
+        if (!film.save(checkpointPath)) {
+            std::cerr << "Partial film " << std::filesystem::absolute(checkpointPath) << " can't be written.\n";
+            return 1;
         }
+        std::cout << "Partial film written to " << std::filesystem::absolute(checkpointPath) << '\n';
+        return 0;
+    }
+
+    std::vector<Vec3> image = developImage(film, job.threadCount);
+    std::filesystem::path outPath = std::filesystem::absolute(job.outputPath);
+    if (!writePPM(outPath, width, height, image)) {
+        std::cerr << "Output image " << outPath << " can't be written.\n";
+        return 1;
     }
-    fclose(fp);
     std::cout << "Output image written to " << outPath << '\n';
 }
\ No newline at end of file